@@ -0,0 +1,967 @@
+#include "Assembler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    // How an instruction's operands are encoded into its opcode, followed by the directives.
+    enum Form : uint8_t {
+        Implied,        // opcode
+        Source8,        // opcode | r
+        Dest8,          // opcode | r << 3
+        Move,           // opcode | d << 3 | s
+        Pair,           // opcode | rp << 4, with b, d, h or sp
+        PairBD,         // ldax/stax: b or d
+        PairPSW,        // push/pop: psw instead of sp
+        Byte,           // opcode, n
+        Word,           // opcode, nn
+        Dest8Byte,      // mvi
+        PairWord,       // lxi
+        Vector,         // rst
+        Org, Db, Dw, Ds, Equ, End
+    };
+
+    static const uint8_t FormSizes[] = { 1, 1, 1, 1, 1, 1, 1, 2, 3, 2, 3, 1, 0, 0, 0, 0, 0, 0 };
+
+    struct Mnemonic {
+        const char *name;
+        Form form;
+        uint8_t opcode;
+    };
+
+    static const Mnemonic Mnemonics[] = {
+        { "mov", Move, 0x40 }, { "mvi", Dest8Byte, 0x06 }, { "lxi", PairWord, 0x01 },
+        { "lda", Word, 0x3a }, { "sta", Word, 0x32 }, { "lhld", Word, 0x2a }, { "shld", Word, 0x22 },
+        { "ldax", PairBD, 0x0a }, { "stax", PairBD, 0x02 }, { "xchg", Implied, 0xeb },
+        { "add", Source8, 0x80 }, { "adc", Source8, 0x88 }, { "sub", Source8, 0x90 }, { "sbb", Source8, 0x98 },
+        { "ana", Source8, 0xa0 }, { "xra", Source8, 0xa8 }, { "ora", Source8, 0xb0 }, { "cmp", Source8, 0xb8 },
+        { "adi", Byte, 0xc6 }, { "aci", Byte, 0xce }, { "sui", Byte, 0xd6 }, { "sbi", Byte, 0xde },
+        { "ani", Byte, 0xe6 }, { "xri", Byte, 0xee }, { "ori", Byte, 0xf6 }, { "cpi", Byte, 0xfe },
+        { "inr", Dest8, 0x04 }, { "dcr", Dest8, 0x05 }, { "inx", Pair, 0x03 }, { "dcx", Pair, 0x0b },
+        { "dad", Pair, 0x09 }, { "daa", Implied, 0x27 },
+        { "rlc", Implied, 0x07 }, { "rrc", Implied, 0x0f }, { "ral", Implied, 0x17 }, { "rar", Implied, 0x1f },
+        { "cma", Implied, 0x2f }, { "cmc", Implied, 0x3f }, { "stc", Implied, 0x37 },
+        { "jmp", Word, 0xc3 }, { "call", Word, 0xcd }, { "ret", Implied, 0xc9 },
+        { "jnz", Word, 0xc2 }, { "jz", Word, 0xca }, { "jnc", Word, 0xd2 }, { "jc", Word, 0xda },
+        { "jpo", Word, 0xe2 }, { "jpe", Word, 0xea }, { "jp", Word, 0xf2 }, { "jm", Word, 0xfa },
+        { "cnz", Word, 0xc4 }, { "cz", Word, 0xcc }, { "cnc", Word, 0xd4 }, { "cc", Word, 0xdc },
+        { "cpo", Word, 0xe4 }, { "cpe", Word, 0xec }, { "cp", Word, 0xf4 }, { "cm", Word, 0xfc },
+        { "rnz", Implied, 0xc0 }, { "rz", Implied, 0xc8 }, { "rnc", Implied, 0xd0 }, { "rc", Implied, 0xd8 },
+        { "rpo", Implied, 0xe0 }, { "rpe", Implied, 0xe8 }, { "rp", Implied, 0xf0 }, { "rm", Implied, 0xf8 },
+        { "rst", Vector, 0xc7 }, { "pchl", Implied, 0xe9 }, { "push", PairPSW, 0xc5 }, { "pop", PairPSW, 0xc1 },
+        { "xthl", Implied, 0xe3 }, { "sphl", Implied, 0xf9 }, { "in", Byte, 0xdb }, { "out", Byte, 0xd3 },
+        { "ei", Implied, 0xfb }, { "di", Implied, 0xf3 }, { "hlt", Implied, 0x76 }, { "nop", Implied, 0x00 },
+        { "org", Org, 0 }, { "db", Db, 0 }, { "dw", Dw, 0 }, { "ds", Ds, 0 }, { "equ", Equ, 0 }, { "end", End, 0 }
+    };
+
+    static const size_t MnemonicCount = sizeof(Mnemonics) / sizeof(Mnemonics[0]);
+    static const uint8_t NoMnemonic = 0xff;
+    static const uint8_t LabelOnly = 0xfe;
+
+    // Every mnemonic fits in four characters, so a word is packed into a 32-bit key and hashed with a single
+    // multiply. The multiplier is searched for once so that no two mnemonics share a slot; a lookup is then
+    // one multiply, one slot read and one key compare.
+    static const uint32_t MnemonicHashBits = 9;
+
+    struct MnemonicIndex {
+        uint32_t multiplier;
+        uint32_t keys[MnemonicCount];
+        uint8_t slots[1 << MnemonicHashBits];
+    };
+
+    static inline uint32_t MnemonicKey(const char *word, size_t length)
+    {
+        if (length > 4)
+            return 0;
+
+        uint32_t key = 0;
+
+        for (size_t i = 0; i < length; i++) {
+            char c = word[i];
+            key = (key << 8) | (uint8_t)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+        }
+
+        return key;
+    }
+
+    static inline uint32_t MnemonicSlot(uint32_t key, uint32_t multiplier)
+    {
+        return (key * multiplier) >> (32 - MnemonicHashBits);
+    }
+
+    static MnemonicIndex BuildMnemonicIndex()
+    {
+        MnemonicIndex index;
+
+        for (size_t i = 0; i < MnemonicCount; i++)
+            index.keys[i] = MnemonicKey(Mnemonics[i].name, strlen(Mnemonics[i].name));
+
+        index.multiplier = 0x9e3779b1;
+
+        for (;;) {
+            memset(index.slots, NoMnemonic, sizeof(index.slots));
+
+            size_t i = 0;
+
+            for (; i < MnemonicCount; i++) {
+                uint8_t &slot = index.slots[MnemonicSlot(index.keys[i], index.multiplier)];
+
+                if (slot != NoMnemonic)
+                    break;
+
+                slot = (uint8_t)i;
+            }
+
+            if (i == MnemonicCount)
+                return index;
+
+            index.multiplier = (index.multiplier * 1664525 + 1013904223) | 1;
+        }
+    }
+
+    static uint8_t FindMnemonic(const char *word, size_t length)
+    {
+        static const MnemonicIndex index = BuildMnemonicIndex();
+
+        uint32_t key = MnemonicKey(word, length);
+
+        if (key == 0)
+            return NoMnemonic;
+
+        uint8_t mnemonic = index.slots[MnemonicSlot(key, index.multiplier)];
+        return mnemonic != NoMnemonic && index.keys[mnemonic] == key ? mnemonic : NoMnemonic;
+    }
+
+    static inline bool IsIdentifierStart(char c)
+    {
+        return isalpha((unsigned char)c) || c == '_' || c == '.' || c == '?' || c == '@';
+    }
+
+    static inline bool IsIdentifierChar(char c)
+    {
+        return IsIdentifierStart(c) || isdigit((unsigned char)c);
+    }
+
+    static bool IsRegisterName(const char *word, size_t length)
+    {
+        static const char * const names[] = { "a", "b", "c", "d", "e", "h", "l", "m", "sp", "psw" };
+
+        for (auto name : names) {
+            if (strlen(name) == length && strncasecmp(word, name, length) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    Assembler::Assembler()
+    {
+        this->image = new uint8_t[0x10000];
+        memset(this->image, 0, 0x10000);
+
+        this->start = 0x10000;
+        this->end = 0;
+    }
+
+    Assembler::~Assembler()
+    {
+        delete[] this->image;
+    }
+
+    void Assembler::Fail(const char * const message) const
+    {
+        throw std::runtime_error(FormatString("Line %u: %s", this->lineIndex + 1, message));
+    }
+
+    char Assembler::Peek()
+    {
+        return this->cursor < this->limit ? *this->cursor : '\0';
+    }
+
+    void Assembler::SkipSpaces()
+    {
+        while (this->cursor < this->limit && (*this->cursor == ' ' || *this->cursor == '\t'))
+            this->cursor++;
+    }
+
+    bool Assembler::AtEnd()
+    {
+        this->SkipSpaces();
+        return this->cursor == this->limit;
+    }
+
+    void Assembler::Expect(char c)
+    {
+        this->SkipSpaces();
+
+        if (this->Peek() != c)
+            this->Fail(FormatString("Expected '%c'.", c).c_str());
+
+        this->cursor++;
+    }
+
+    size_t Assembler::ReadIdentifier()
+    {
+        const char *word = this->cursor;
+
+        if (!IsIdentifierStart(this->Peek()))
+            return 0;
+
+        while (this->cursor < this->limit && IsIdentifierChar(*this->cursor))
+            this->cursor++;
+
+        return this->cursor - word;
+    }
+
+    int32_t Assembler::ParseNumber()
+    {
+        const char *word = this->cursor;
+        int radix = 10;
+
+        if (*word == '$') {
+            word = ++this->cursor;
+            radix = 16;
+        }
+
+        while (this->cursor < this->limit && isalnum((unsigned char)*this->cursor))
+            this->cursor++;
+
+        const char *wordEnd = this->cursor;
+        char suffix = (char)tolower((unsigned char)wordEnd[-1]);
+
+        if (radix == 10) {
+            if (wordEnd - word > 2 && word[0] == '0' && (word[1] == 'x' || word[1] == 'X')) {
+                word += 2;
+                radix = 16;
+            } else if (suffix == 'h') {
+                wordEnd--;
+                radix = 16;
+            } else if (suffix == 'o' || suffix == 'q') {
+                wordEnd--;
+                radix = 8;
+            } else if (suffix == 'b' && wordEnd - word > 1 && strspn(word, "01") == (size_t)(wordEnd - word - 1)) {
+                wordEnd--;
+                radix = 2;
+            }
+        }
+
+        uint32_t value = 0;
+
+        for (const char *s = word; s < wordEnd; s++) {
+            char c = (char)tolower((unsigned char)*s);
+            int digit = isdigit((unsigned char)c) ? c - '0' : (c >= 'a' && c <= 'f' ? c - 'a' + 10 : 99);
+
+            if (digit >= radix || value > 0xffff)
+                this->Fail(FormatString("Invalid number '%.*s'.", (int)(this->cursor - word), word).c_str());
+
+            value = value * radix + digit;
+        }
+
+        if (value > 0xffff)
+            this->Fail(FormatString("Number '%.*s' does not fit in 16 bits.", (int)(this->cursor - word), word).c_str());
+
+        return (int32_t)value;
+    }
+
+    int32_t Assembler::ParsePrimary()
+    {
+        this->SkipSpaces();
+        char c = this->Peek();
+
+        switch (c) {
+            case '(': {
+                this->cursor++;
+                int32_t value = this->ParseBinary(1);
+                this->Expect(')');
+                return value;
+            }
+
+            case '-':
+                this->cursor++;
+                return -this->ParsePrimary();
+
+            case '+':
+                this->cursor++;
+                return this->ParsePrimary();
+
+            case '~':
+                this->cursor++;
+                return ~this->ParsePrimary();
+
+            case '$':
+                if (this->cursor + 1 < this->limit && isxdigit((unsigned char)this->cursor[1]))
+                    return this->ParseNumber();
+
+                this->cursor++;
+                return (int32_t)this->address;
+
+            case '\'':
+                if (this->cursor + 2 >= this->limit || this->cursor[2] != '\'')
+                    this->Fail("Invalid character literal.");
+
+                this->cursor += 3;
+                return (uint8_t)this->cursor[-2];
+        }
+
+        if (isdigit((unsigned char)c))
+            return this->ParseNumber();
+
+        const char *word = this->cursor;
+        size_t length = this->ReadIdentifier();
+
+        if (length == 0)
+            this->Fail(c == '\0' ? "Expected an expression." : FormatString("Unexpected '%c' in expression.", c).c_str());
+
+        this->SkipSpaces();
+
+        if (this->Peek() == '(') {
+            if (length == 3 && strncasecmp(word, "low", 3) == 0)
+                return this->ParsePrimary() & 0xff;
+            if (length == 4 && strncasecmp(word, "high", 4) == 0)
+                return (this->ParsePrimary() >> 8) & 0xff;
+        }
+
+        auto it = this->symbols.find(std::string(word, length));
+
+        if (it != this->symbols.end() && it->second.resolved)
+            return it->second.value;
+
+        // Forward references are fine until pass 2.
+        if (this->emit)
+            this->Fail(FormatString("Undefined symbol '%.*s'.", (int)length, word).c_str());
+
+        this->resolved = false;
+        return 0;
+    }
+
+    // Precedence climbing over the C binary operators: | ^ & << >> + - * / %.
+    int32_t Assembler::ParseBinary(int precedence)
+    {
+        int32_t left = this->ParsePrimary();
+
+        for (;;) {
+            this->SkipSpaces();
+
+            char c = this->Peek();
+            char next = this->cursor + 1 < this->limit ? this->cursor[1] : '\0';
+            int level, width = 1;
+
+            switch (c) {
+                case '|': level = 1; break;
+                case '^': level = 2; break;
+                case '&': level = 3; break;
+                case '<': case '>':
+                    if (next != c)
+                        return left;
+                    level = 4;
+                    width = 2;
+                    break;
+                case '+': case '-': level = 5; break;
+                case '*': case '/': case '%': level = 6; break;
+                default: return left;
+            }
+
+            if (level < precedence)
+                return left;
+
+            this->cursor += width;
+            int32_t right = this->ParseBinary(level + 1);
+
+            switch (c) {
+                case '|': left |= right; break;
+                case '^': left ^= right; break;
+                case '&': left &= right; break;
+                case '<': left = (int32_t)((uint32_t)left << (right & 31)); break;
+                case '>': left >>= right & 31; break;
+                case '+': left += right; break;
+                case '-': left -= right; break;
+                case '*': left *= right; break;
+                case '/': case '%':
+                    if (right == 0) {
+                        // In pass 1 an unresolved symbol reads as 0.
+                        if (this->resolved)
+                            this->Fail("Division by zero.");
+                        left = 0;
+                    } else {
+                        left = c == '/' ? left / right : left % right;
+                    }
+                    break;
+            }
+        }
+    }
+
+    int32_t Assembler::Evaluate()
+    {
+        this->resolved = true;
+        return this->ParseBinary(1);
+    }
+
+    int32_t Assembler::EvaluateDefined(const char * const directive)
+    {
+        int32_t value = this->Evaluate();
+
+        if (!this->resolved)
+            this->Fail(FormatString("The operand of %s must only use symbols defined above it.", directive).c_str());
+
+        return value;
+    }
+
+    uint8_t Assembler::ParseRegister8()
+    {
+        this->SkipSpaces();
+
+        const char *word = this->cursor;
+        size_t length = this->ReadIdentifier();
+
+        if (length == 1) {
+            const char *found = strchr("bcdehlma", tolower((unsigned char)*word));
+
+            if (found != nullptr)
+                return (uint8_t)(found - "bcdehlma");
+        }
+
+        this->Fail("Expected a register: a, b, c, d, e, h, l or m.");
+    }
+
+    uint8_t Assembler::ParseRegisterPair(uint8_t form)
+    {
+        this->SkipSpaces();
+
+        const char *word = this->cursor;
+        size_t length = this->ReadIdentifier();
+        char c = (char)tolower((unsigned char)*word);
+
+        if (length == 1 && (c == 'b' || c == 'd' || (c == 'h' && form != PairBD)))
+            return c == 'b' ? 0 : (c == 'd' ? 1 : 2);
+        if (length == 2 && form == Pair && strncasecmp(word, "sp", 2) == 0)
+            return 3;
+        if (length == 3 && form == PairPSW && strncasecmp(word, "psw", 3) == 0)
+            return 3;
+
+        this->Fail(form == PairBD ? "Expected register pair b or d." : (form == PairPSW ? "Expected register pair b, d, h or psw." : "Expected register pair b, d, h or sp."));
+    }
+
+    // Reads a db/dw operand list and returns its size, emitting it in pass 2. Strings are only allowed in db;
+    // a one-character string is a character literal, so it can be used in an expression.
+    uint32_t Assembler::ParseData(uint32_t width)
+    {
+        uint32_t size = 0;
+
+        do {
+            this->SkipSpaces();
+
+            char c = this->Peek();
+            const char *close = nullptr;
+
+            if (width == 1 && (c == '"' || c == '\'')) {
+                close = (const char *)memchr(this->cursor + 1, c, this->limit - this->cursor - 1);
+
+                if (close == nullptr)
+                    this->Fail("Unterminated string.");
+                if (c == '\'' && close - this->cursor == 2)
+                    close = nullptr;
+            }
+
+            if (close != nullptr) {
+                if (this->emit) {
+                    for (const char *s = this->cursor + 1; s < close; s++)
+                        this->Emit((uint8_t)*s);
+                }
+
+                size += close - this->cursor - 1;
+                this->cursor = close + 1;
+            } else {
+                int32_t value = this->Evaluate();
+
+                if (this->emit) {
+                    if (width == 1 && (value < -128 || value > 0xff))
+                        this->Fail(FormatString("Value %d does not fit in a byte.", value).c_str());
+                    if (width == 2 && (value < -32768 || value > 0xffff))
+                        this->Fail(FormatString("Value %d does not fit in a word.", value).c_str());
+
+                    this->Emit(value & 0xff);
+
+                    if (width == 2)
+                        this->Emit((value >> 8) & 0xff);
+                }
+
+                size += width;
+            }
+
+            if (this->AtEnd())
+                return size;
+
+            this->Expect(',');
+        } while (true);
+    }
+
+    void Assembler::Define(const char * const name, size_t length, int32_t value, bool resolved, bool label)
+    {
+        if (IsRegisterName(name, length))
+            this->Fail(FormatString("'%.*s' is a register name.", (int)length, name).c_str());
+
+        Definition definition = { value, this->lineIndex, resolved, label };
+        auto result = this->symbols.emplace(std::string(name, length), definition);
+
+        if (!result.second)
+            this->Fail(FormatString("'%.*s' is already defined on line %u.", (int)length, name, result.first->second.line + 1).c_str());
+    }
+
+    void Assembler::Emit(uint8_t byte)
+    {
+        this->image[this->address++] = byte;
+    }
+
+    void Assembler::FirstPass()
+    {
+        const char *text = this->source.data();
+        const char *textEnd = text + this->source.size();
+
+        this->emit = false;
+        this->address = 0;
+
+        for (const char *lineStart = text; lineStart < textEnd;) {
+            const char *newline = (const char *)memchr(lineStart, '\n', textEnd - lineStart);
+            const char *lineEnd = newline != nullptr ? newline : textEnd;
+            const char *next = newline != nullptr ? newline + 1 : textEnd;
+
+            if (lineEnd > lineStart && lineEnd[-1] == '\r')
+                lineEnd--;
+
+            // The comment starts at the first ';' outside a string.
+            const char *contentEnd = lineStart;
+            char quote = 0;
+
+            for (; contentEnd < lineEnd; contentEnd++) {
+                char c = *contentEnd;
+
+                if (quote != 0) {
+                    if (c == quote)
+                        quote = 0;
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == ';') {
+                    break;
+                }
+            }
+
+            Line line = { (uint32_t)(lineStart - text), (uint32_t)(lineEnd - lineStart), 0, 0, this->address, 0, NoMnemonic };
+
+            this->lineIndex = (uint32_t)this->lines.size();
+            this->cursor = lineStart;
+            this->limit = contentEnd;
+            lineStart = next;
+
+            const char *label = nullptr;
+            size_t labelLength = 0;
+
+            if (!this->AtEnd()) {
+                const char *word = this->cursor;
+                size_t length = this->ReadIdentifier();
+
+                if (length == 0)
+                    this->Fail(FormatString("Unexpected '%c'.", *word).c_str());
+
+                if (this->Peek() == ':') {
+                    this->cursor++;
+                    label = word;
+                    labelLength = length;
+                } else if ((line.mnemonic = FindMnemonic(word, length)) == NoMnemonic) {
+                    label = word;
+                    labelLength = length;
+                }
+
+                if (line.mnemonic == NoMnemonic && !this->AtEnd()) {
+                    const char *op = this->cursor;
+                    size_t opLength = this->ReadIdentifier();
+
+                    if ((line.mnemonic = FindMnemonic(op, opLength)) == NoMnemonic) {
+                        // Without a colon the first word was more likely a misspelled instruction.
+                        if (word[length] != ':')
+                            op = word, opLength = length;
+                        this->Fail(FormatString("Unknown instruction '%.*s'.", (int)(opLength > 0 ? opLength : 1), op).c_str());
+                    }
+                }
+
+                if (line.mnemonic == NoMnemonic)
+                    line.mnemonic = LabelOnly;
+            }
+
+            this->SkipSpaces();
+            line.operands = (uint32_t)(this->cursor - text);
+            line.operandsEnd = (uint32_t)(contentEnd - text);
+
+            Form form = line.mnemonic < MnemonicCount ? Mnemonics[line.mnemonic].form : Implied;
+            uint32_t reserved = 0;
+
+            if (line.mnemonic >= MnemonicCount) {
+                // A blank line or a label on its own.
+            } else if (form < Org) {
+                line.size = FormSizes[form];
+            } else if (form == Org) {
+                int32_t value = this->EvaluateDefined("org");
+
+                if (value < 0 || value > 0xffff)
+                    this->Fail(FormatString("Origin %d is outside memory.", value).c_str());
+
+                this->address = line.address = (uint32_t)value;
+            } else if (form == Ds) {
+                int32_t value = this->EvaluateDefined("ds");
+
+                if (value < 0)
+                    this->Fail("ds needs a size of at least 0.");
+
+                // ds only reserves space, so it moves the address without emitting anything.
+                reserved = (uint32_t)value;
+            } else if (form == Db || form == Dw) {
+                line.size = this->ParseData(form == Db ? 1 : 2);
+            } else if (form == Equ) {
+                if (label == nullptr)
+                    this->Fail("equ needs a name.");
+
+                int32_t value = this->Evaluate();
+
+                if (this->resolved)
+                    line.address = (uint32_t)value & 0xffff;
+                else
+                    this->pending.push_back(std::make_pair(this->lineIndex, std::string(label, labelLength)));
+
+                this->Define(label, labelLength, value & 0xffff, this->resolved, false);
+                label = nullptr;
+            }
+
+            // Pass 2 checks what follows the operands of the lines it emits; these emit nothing, so check here.
+            if ((form == Org || form == Ds || form == Equ || form == End) && line.mnemonic < MnemonicCount && !this->AtEnd())
+                this->Fail(FormatString("Unexpected '%.*s'.", (int)(this->limit - this->cursor), this->cursor).c_str());
+
+            if (label != nullptr)
+                this->Define(label, labelLength, (int32_t)line.address, true, true);
+
+            if (this->address + line.size + reserved > 0x10000)
+                this->Fail("Code runs past the end of memory.");
+
+            this->address += line.size + reserved;
+            this->lines.push_back(line);
+
+            if (line.mnemonic < MnemonicCount && form == End)
+                break;
+        }
+    }
+
+    // equ may refer to symbols defined further down, including other equs, so keep evaluating the ones that
+    // failed in pass 1 until they all resolve or a pass makes no progress.
+    void Assembler::ResolvePending()
+    {
+        bool progress = true;
+
+        while (!this->pending.empty() && progress) {
+            progress = false;
+
+            for (size_t i = 0; i < this->pending.size();) {
+                Line &line = this->lines[this->pending[i].first];
+
+                this->lineIndex = this->pending[i].first;
+                this->address = line.address;
+                this->cursor = this->source.data() + line.operands;
+                this->limit = this->source.data() + line.operandsEnd;
+
+                int32_t value = this->Evaluate();
+
+                if (!this->resolved) {
+                    i++;
+                    continue;
+                }
+
+                Definition &definition = this->symbols[this->pending[i].second];
+                definition.value = value & 0xffff;
+                definition.resolved = true;
+                line.address = (uint32_t)value & 0xffff;
+
+                this->pending.erase(this->pending.begin() + i);
+                progress = true;
+            }
+        }
+
+        if (!this->pending.empty()) {
+            this->lineIndex = this->pending[0].first;
+            this->Fail(FormatString("Cannot resolve '%s'; it uses an undefined symbol or refers to itself.", this->pending[0].second.c_str()).c_str());
+        }
+    }
+
+    void Assembler::SecondPass()
+    {
+        const char *text = this->source.data();
+
+        this->emit = true;
+
+        for (uint32_t i = 0; i < this->lines.size(); i++) {
+            const Line &line = this->lines[i];
+
+            if (line.mnemonic >= MnemonicCount || line.size == 0)
+                continue;
+
+            const Mnemonic &mnemonic = Mnemonics[line.mnemonic];
+
+            this->lineIndex = i;
+            this->address = line.address;
+            this->cursor = text + line.operands;
+            this->limit = text + line.operandsEnd;
+
+            uint8_t opcode = mnemonic.opcode;
+            int32_t value = 0;
+
+            switch (mnemonic.form) {
+                case Source8:
+                    opcode |= this->ParseRegister8();
+                    break;
+
+                case Dest8:
+                    opcode |= this->ParseRegister8() << 3;
+                    break;
+
+                case Move: {
+                    uint8_t destination = this->ParseRegister8();
+                    this->Expect(',');
+                    uint8_t source = this->ParseRegister8();
+
+                    // This encoding is hlt.
+                    if (destination == 6 && source == 6)
+                        this->Fail("mov m, m is not an instruction.");
+
+                    opcode |= destination << 3 | source;
+                    break;
+                }
+
+                case Pair:
+                case PairBD:
+                case PairPSW:
+                    opcode |= this->ParseRegisterPair(mnemonic.form) << 4;
+                    break;
+
+                case Dest8Byte:
+                    opcode |= this->ParseRegister8() << 3;
+                    this->Expect(',');
+                    value = this->Evaluate();
+                    break;
+
+                case PairWord:
+                    opcode |= this->ParseRegisterPair(Pair) << 4;
+                    this->Expect(',');
+                    value = this->Evaluate();
+                    break;
+
+                case Byte:
+                case Word:
+                    value = this->Evaluate();
+                    break;
+
+                case Vector:
+                    value = this->Evaluate();
+
+                    if (value < 0 || value > 7)
+                        this->Fail(FormatString("rst vector %d is not 0-7.", value).c_str());
+
+                    opcode |= value << 3;
+                    break;
+
+                case Db:
+                case Dw:
+                    this->ParseData(mnemonic.form == Db ? 1 : 2);
+                    break;
+
+                default:
+                    break;
+            }
+
+            if (mnemonic.form < Org) {
+                if (line.size == 2 && (value < -128 || value > 0xff))
+                    this->Fail(FormatString("Value %d does not fit in a byte.", value).c_str());
+                if (line.size == 3 && (value < -32768 || value > 0xffff))
+                    this->Fail(FormatString("Value %d does not fit in a word.", value).c_str());
+
+                this->Emit(opcode);
+
+                if (line.size > 1)
+                    this->Emit(value & 0xff);
+                if (line.size > 2)
+                    this->Emit((value >> 8) & 0xff);
+            }
+
+            if (!this->AtEnd())
+                this->Fail(FormatString("Unexpected '%.*s'.", (int)(this->limit - this->cursor), this->cursor).c_str());
+
+            this->start = std::min(this->start, line.address);
+            this->end = std::max(this->end, line.address + line.size);
+        }
+    }
+
+    void Assembler::Assemble(const std::string &source)
+    {
+        this->source = source;
+        this->lines.clear();
+        this->symbols.clear();
+        this->pending.clear();
+
+        memset(this->image, 0, 0x10000);
+        this->start = 0x10000;
+        this->end = 0;
+
+        this->lines.reserve(std::count(source.begin(), source.end(), '\n') + 1);
+
+        this->FirstPass();
+        this->ResolvePending();
+        this->SecondPass();
+    }
+
+    void Assembler::AssembleFile(const char * const filename)
+    {
+        FILE *file = fopen(filename, "rb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        std::string source(size > 0 ? (size_t)size : 0, '\0');
+        bool ok = size >= 0 && fread(&source[0], 1, source.size(), file) == source.size();
+        fclose(file);
+
+        if (!ok)
+            throw std::runtime_error(FormatString("Failed to read file '%s'.", filename));
+
+        this->Assemble(source);
+    }
+
+    const uint8_t * const Assembler::GetImage() const { return this->image; }
+    uint16_t Assembler::GetStart() const { return this->start < this->end ? (uint16_t)this->start : 0; }
+    uint32_t Assembler::GetEnd() const { return this->end; }
+    size_t Assembler::GetLineCount() const { return this->lines.size(); }
+
+    bool Assembler::GetSymbol(const std::string &name, uint16_t *value) const
+    {
+        auto it = this->symbols.find(name);
+
+        if (it == this->symbols.end())
+            return false;
+
+        if (value != nullptr)
+            *value = (uint16_t)it->second.value;
+
+        return true;
+    }
+
+    void Assembler::ExportSymbols(SymbolMap * const symbols) const
+    {
+        std::vector<std::pair<uint16_t, const std::string *>> labels;
+
+        for (auto &symbol : this->symbols) {
+            if (symbol.second.label)
+                labels.push_back(std::make_pair((uint16_t)symbol.second.value, &symbol.first));
+        }
+
+        // Adding in address order appends, rather than inserting into the middle of the map.
+        std::sort(labels.begin(), labels.end(), [](const std::pair<uint16_t, const std::string *> &a, const std::pair<uint16_t, const std::string *> &b) {
+            return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+        });
+
+        for (auto &label : labels)
+            symbols->Add(label.first, *label.second);
+    }
+
+    // "line  addr  bytes        source"; db/dw lines with more than four bytes continue on extra lines, and
+    // equ lines show their value in the address column.
+    std::string Assembler::ToListing() const
+    {
+        std::string listing;
+        char prefix[64];
+
+        listing.reserve(this->source.size() * 2);
+
+        for (uint32_t i = 0; i < this->lines.size(); i++) {
+            const Line &line = this->lines[i];
+            int length;
+
+            if (line.mnemonic == NoMnemonic) {
+                length = snprintf(prefix, sizeof(prefix), "%5u                     ", i + 1);
+            } else if (line.mnemonic < MnemonicCount && Mnemonics[line.mnemonic].form == Equ) {
+                length = snprintf(prefix, sizeof(prefix), "%5u  %04x  =            ", i + 1, line.address);
+            } else {
+                char bytes[16] = "";
+                char *out = bytes;
+
+                for (uint32_t j = 0; j < line.size && j < 4; j++)
+                    out += snprintf(out, bytes + sizeof(bytes) - out, j == 0 ? "%02x" : " %02x", this->image[line.address + j]);
+
+                length = snprintf(prefix, sizeof(prefix), "%5u  %04x  %-11s  ", i + 1, line.address & 0xffff, bytes);
+            }
+
+            listing.append(prefix, length);
+            listing.append(this->source, line.start, line.length);
+            listing += '\n';
+
+            for (uint32_t j = 4; j < line.size; j += 4) {
+                char bytes[16] = "";
+                char *out = bytes;
+
+                for (uint32_t k = j; k < line.size && k < j + 4; k++)
+                    out += snprintf(out, bytes + sizeof(bytes) - out, k == j ? "%02x" : " %02x", this->image[line.address + k]);
+
+                length = snprintf(prefix, sizeof(prefix), "       %04x  %s\n", line.address + j, bytes);
+                listing.append(prefix, length);
+            }
+        }
+
+        return listing;
+    }
+
+    void Assembler::SaveBinary(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "wb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        uint32_t start = this->GetStart();
+        bool ok = true;
+
+        if (this->end > start)
+            ok = fwrite(this->image + start, 1, this->end - start, file) == this->end - start;
+
+        if (fclose(file) != 0)
+            ok = false;
+
+        if (!ok)
+            throw std::runtime_error(FormatString("Failed to write binary '%s'.", filename));
+    }
+
+    void Assembler::SaveListing(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "w");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        std::string listing = this->ToListing();
+        bool ok = fwrite(listing.data(), 1, listing.size(), file) == listing.size();
+
+        if (fclose(file) != 0)
+            ok = false;
+
+        if (!ok)
+            throw std::runtime_error(FormatString("Failed to write listing '%s'.", filename));
+    }
+
+    void Assembler::SaveSymbols(const char * const filename) const
+    {
+        SymbolMap symbols;
+        this->ExportSymbols(&symbols);
+        symbols.SaveToFile(filename);
+    }
+}
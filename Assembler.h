@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    // A two-pass 8080 assembler. Each line is "[label[:]] [mnemonic [operands]] [; comment]"; a label needs its
+    // colon only when it starts with a mnemonic or directive name. Operands are expressions over numbers
+    // (decimal, $ff, 0xff, 0ffh, 1010b, 17o), character literals, symbols, $ for the current address, the
+    // C operators and low()/high(). Directives are org, db, dw, ds, equ and end.
+    //
+    // Pass 1 sizes every line and assigns label addresses; equ may refer forward and is resolved once the
+    // labels are known, but org and ds must only use symbols defined above them. Pass 2 evaluates the
+    // operands of the lines pass 1 recorded, so the source is only tokenized once. Errors throw with the
+    // line number.
+    class Assembler {
+        private:
+            struct Line {
+                uint32_t start;
+                uint32_t length;
+                uint32_t operands;
+                uint32_t operandsEnd;
+                uint32_t address;
+                uint32_t size;
+                uint8_t mnemonic;
+            };
+
+            struct Definition {
+                int32_t value;
+                uint32_t line;
+                bool resolved;
+                bool label;
+            };
+
+            std::string source;
+            std::vector<Line> lines;
+            std::unordered_map<std::string, Definition> symbols;
+            std::vector<std::pair<uint32_t, std::string>> pending;
+
+            uint8_t *image;
+            uint32_t start;
+            uint32_t end;
+
+            // Parser state
+            const char *cursor;
+            const char *limit;
+            uint32_t address;
+            uint32_t lineIndex;
+            bool emit;
+            bool resolved;
+
+            [[noreturn]] void Fail(const char * const message) const;
+            char Peek();
+            void SkipSpaces();
+            bool AtEnd();
+            void Expect(char c);
+            size_t ReadIdentifier();
+
+            int32_t ParseNumber();
+            int32_t ParsePrimary();
+            int32_t ParseBinary(int precedence);
+            int32_t Evaluate();
+            int32_t EvaluateDefined(const char * const directive);
+            uint8_t ParseRegister8();
+            uint8_t ParseRegisterPair(uint8_t form);
+            uint32_t ParseData(uint32_t width);
+
+            void Define(const char * const name, size_t length, int32_t value, bool resolved, bool label);
+            void FirstPass();
+            void ResolvePending();
+            void SecondPass();
+            void Emit(uint8_t byte);
+
+        public:
+            Assembler();
+            ~Assembler();
+
+            void Assemble(const std::string &source);
+            void AssembleFile(const char * const filename);
+
+            // Results; the image is 64K and GetStart/GetEnd bound the bytes that were emitted.
+            const uint8_t * const GetImage() const;
+            uint16_t GetStart() const;
+            uint32_t GetEnd() const;
+            size_t GetLineCount() const;
+            bool GetSymbol(const std::string &name, uint16_t *value) const;
+
+            // Labels go to the symbol map; equ constants are not addresses, so only the listing shows them.
+            void ExportSymbols(SymbolMap * const symbols) const;
+            std::string ToListing() const;
+
+            void SaveBinary(const char * const filename) const;
+            void SaveListing(const char * const filename) const;
+            void SaveSymbols(const char * const filename) const;
+    };
+}
@@ -1,6 +1,7 @@
 #include "CPU.h"
 
 #include <stdexcept>
+#include <algorithm>
 #include "Util.h"
 #include "Encode.h"
 
@@ -108,6 +109,11 @@ namespace Emu8080
     CPU::CPU(void (*logFunction)(const std::string &), uint32_t memorySize)
     {
         this->logFunction = logFunction;
+        this->ioDelegate = nullptr;
+        this->hooks = 0;
+
+        this->inputCount = 0;
+        this->outputCount = 0;
 
         this->state = new CPUState();
         this->state->SetMemorySize(memorySize);
@@ -134,58 +140,117 @@ namespace Emu8080
     }
 
     CPUState * const CPU::GetState() { return this->state; }
+
     void CPU::SetState(const CPUState * const state) { state->CopyTo(this->state); }
 
+    void CPU::AddDelegate(CPUDelegate * const delegate)
+    {
+        if (delegate == nullptr)
+            throw std::runtime_error("CPUDelegate must not be null.");
+
+        uint32_t hooks = delegate->GetHooks() & HookAll;
+
+        this->delegates.push_back(delegate);
+
+        for (int i = 0; i < CPUHookCount; i++) {
+            if (hooks & (1 << i))
+                this->hookDelegates[i].push_back(delegate);
+        }
+
+        this->hooks |= hooks;
+    }
+
+    void CPU::RemoveDelegate(CPUDelegate * const delegate)
+    {
+        this->delegates.erase(std::remove(this->delegates.begin(), this->delegates.end(), delegate), this->delegates.end());
+        this->hooks = 0;
+
+        for (int i = 0; i < CPUHookCount; i++) {
+            auto &list = this->hookDelegates[i];
+            list.erase(std::remove(list.begin(), list.end(), delegate), list.end());
+
+            if (!list.empty())
+                this->hooks |= 1 << i;
+        }
+    }
+
+    const std::vector<CPUDelegate *> &CPU::GetDelegates() const { return this->delegates; }
+    const std::vector<CPUDelegate *> &CPU::GetDelegates(CPUHook hook) const { return this->hookDelegates[__builtin_ctz(hook)]; }
+    uint32_t CPU::GetHooks() const { return this->hooks; }
+
     template<typename ... Args>
-    void CPU::Log(const std::string &format, Args ... args) const
+    void CPU::Log(const char * const format, Args ... args) const
     {
         if (this->logFunction != nullptr)
             this->logFunction(FormatString("[CPU] %s", FormatString(format, args ...).c_str()));
     }
 
+    template<typename Hooks>
     void CPU::Write8(uint16_t addr, uint8_t value)
     {
         this->AssertValidAddress(addr);
+
+        Hooks::OnWrite(this, addr, value);
         this->state->WriteByte(addr, value);
 
         this->Log("Wrote 0x%02x to addr 0x%04x.", value, addr);
     }
 
+    void CPU::Write8(uint16_t addr, uint8_t value) { this->Write8<AllHooks>(addr, value); }
+
+    template<typename Hooks>
     void CPU::Write16(uint16_t addr, uint16_t value)
     {
         this->AssertValidAddressRange(addr, addr + 1);
+
+        Hooks::OnWrite(this, addr, value & 0xFF);
+        Hooks::OnWrite(this, addr + 1, value >> 8);
         this->state->WriteByte(addr, value & 0xFF);
         this->state->WriteByte(addr + 1, value >> 8);
 
         this->Log("Wrote 0x%04x to addr 0x%04x.", value, addr);
     }
 
+    void CPU::Write16(uint16_t addr, uint16_t value) { this->Write16<AllHooks>(addr, value); }
+
     void CPU::WriteBytes(uint16_t addr, const uint8_t * const bytes, uint16_t size)
     {
         this->AssertValidAddressRange(addr, addr + size);
+
+        for (uint16_t i = 0; i < size; i++)
+            AllHooks::OnWrite(this, addr + i, bytes[i]);
         this->state->WriteBytes(addr, bytes, size);
 
         this->Log("Write 0x%x bytes to addr 0x%04x.", size, addr);
     }
 
+    template<typename Hooks>
     uint8_t CPU::Read8(uint16_t addr) const
     {
         this->AssertValidAddress(addr);
         auto value = this->state->GetMemory()[addr];
+        Hooks::OnRead(this, addr, value);
 
         this->Log("Read 0x%02x from addr 0x%04x.", value, addr);
         return value;
     }
 
+    uint8_t CPU::Read8(uint16_t addr) const { return this->Read8<AllHooks>(addr); }
+
+    template<typename Hooks>
     uint16_t CPU::Read16(uint16_t addr) const
     {
         this->AssertValidAddressRange(addr, addr + 1);
         auto value = this->state->GetMemory()[addr] | (this->state->GetMemory()[addr + 1] << 8);
+        Hooks::OnRead(this, addr, value & 0xFF);
+        Hooks::OnRead(this, addr + 1, value >> 8);
 
         this->Log("Read 0x%04x from addr 0x%04x.", value, addr);
         return value;
     }
 
+    uint16_t CPU::Read16(uint16_t addr) const { return this->Read16<AllHooks>(addr); }
+
     void CPU::ReadBytes(uint16_t addr, void * const buffer, uint16_t size) const
     {
         this->AssertValidAddressRange(addr, addr + size);
@@ -208,11 +273,12 @@ namespace Emu8080
         this->Log("Wrote 0x%04x to SP.", sp);
     }
 
+    template<typename Hooks>
     void CPU::WriteRegister8(uint8_t r, uint8_t value)
     {
         if (r == 0b110) {
             uint16_t addr = this->ReadRegister16(CPU::RegisterPairHL);
-            this->Write8(addr, value);
+            this->Write8<Hooks>(addr, value);
         } else {
             this->state->SetRegister((r + 1) & 0b111, value);
         }
@@ -220,6 +286,8 @@ namespace Emu8080
         this->Log("Wrote 0x%02x to register %s.", value, StringForRegister8(r));
     }
 
+    void CPU::WriteRegister8(uint8_t r, uint8_t value) { this->WriteRegister8<AllHooks>(r, value); }
+
     void CPU::WriteRegister16(uint8_t r, uint16_t value, bool spAvailable)
     {
         uint8_t lo = value & 0xFF;
@@ -257,13 +325,14 @@ namespace Emu8080
         return this->state->GetSP();
     }
 
+    template<typename Hooks>
     uint8_t CPU::ReadRegister8(uint8_t r) const
     {
         uint8_t value;
 
         if (r == 0b110) {
             uint16_t addr = this->ReadRegister16(CPU::RegisterPairHL);
-            value = this->Read8(addr);
+            value = this->Read8<Hooks>(addr);
         } else {
             value = this->state->GetRegister((r + 1) & 0b111);
         }
@@ -272,6 +341,8 @@ namespace Emu8080
         return value;
     }
 
+    uint8_t CPU::ReadRegister8(uint8_t r) const { return this->ReadRegister8<AllHooks>(r); }
+
     uint16_t CPU::ReadRegister16(uint8_t r, bool spAvailable) const
     {
         uint16_t value;
@@ -363,13 +434,58 @@ namespace Emu8080
         this->state->SetWaitCycles(this->ExecuteInstruction());
     }
 
+    // Runs the bare core until a delegate is attached, and then the cheapest tier covering the attached hooks.
+    uint8_t CPU::ExecuteInstruction()
+    {
+        if (this->hooks == 0)
+            return this->ExecuteInstruction<NoHooks>();
+        if ((this->hooks & (HookRead | HookWrite)) == 0)
+            return this->ExecuteInstruction<ExecutionHooks>();
+        if ((this->hooks & HookRead) == 0)
+            return this->ExecuteInstruction<WriteHooks>();
+
+        return this->ExecuteInstruction<AllHooks>();
+    }
+
+    template<typename Hooks>
     uint8_t CPU::ExecuteInstruction()
     {
         uint16_t pc = this->ReadPC();
-        this->WritePC(pc + 1);
+        uint8_t instruction = 0;
+        uint8_t cycles;
 
-        uint8_t instruction = this->Read8(pc);
-        this->Log("Executing instruction 0x%02x: %s.", instruction, Encode::DecodeInstruction(this->state->GetMemory() + pc).c_str());
+        try {
+            this->AssertValidAddress(pc);
+
+            // Opcode fetches go to OnFetch rather than OnRead.
+            instruction = this->state->GetMemory()[pc];
+            this->flightRecorder.Record(this->state, pc, instruction);
+            Hooks::OnFetch(this, pc, instruction);
+
+            this->WritePC(pc + 1);
+
+            cycles = this->Dispatch<Hooks>(pc, instruction);
+        } catch (const CPUFault &) {
+            throw;
+        } catch (const std::exception &e) {
+            CPUFault fault(e.what(), this->flightRecorder.GetRecords());
+            this->Log("%s\n%s", e.what(), fault.Dump().c_str());
+
+            throw fault;
+        }
+
+        Hooks::OnRetire(this, pc, instruction, cycles);
+        return cycles;
+    }
+
+    const FlightRecorder &CPU::GetFlightRecorder() const { return this->flightRecorder; }
+
+    template<typename Hooks>
+    uint8_t CPU::Dispatch(uint16_t pc, uint8_t instruction)
+    {
+        // Checked here so the disassembly isn't built just to be thrown away.
+        if (this->logFunction != nullptr)
+            this->Log("Executing instruction 0x%02x: %s.", instruction, Encode::DecodeInstruction(this->state->GetMemory() + pc).c_str());
 
         uint8_t field = ExtractBits8(instruction, 7, 2);
 
@@ -386,10 +502,10 @@ namespace Emu8080
                 uint16_t pc = this->ReadPC();
                 this->WritePC(pc + 1);
 
-                uint8_t imm = this->Read8(pc);
+                uint8_t imm = this->Read8<Hooks>(pc);
                 uint8_t dest = ExtractBits8(instruction, 4, 3);
 
-                this->WriteRegister8(dest, imm);
+                this->WriteRegister8<Hooks>(dest, imm);
                 return dest == 0b110 ? 10 : 7;
             }
 
@@ -401,10 +517,10 @@ namespace Emu8080
                     case 0b000: {
                         // rlc
 
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
                         this->SetFlag(CPU::Flag::C, a >> 7);
-                        this->WriteRegister8(CPU::RegisterA, (a << 1) | (a >> 7));
+                        this->WriteRegister8<Hooks>(CPU::RegisterA, (a << 1) | (a >> 7));
                         
                         break;
                     }
@@ -412,10 +528,10 @@ namespace Emu8080
                     case 0b001: {
                         // rrc
                         
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
                         this->SetFlag(CPU::Flag::C, a & 1);
-                        this->WriteRegister8(CPU::RegisterA, (a >> 1) | ((a & 1) << 7));
+                        this->WriteRegister8<Hooks>(CPU::RegisterA, (a >> 1) | ((a & 1) << 7));
 
                         break;
                     }
@@ -424,10 +540,10 @@ namespace Emu8080
                         // ral
 
                         bool carry = this->GetFlag(CPU::Flag::C);
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
                         this->SetFlag(CPU::Flag::C, a >> 7);
-                        this->WriteRegister8(CPU::RegisterA, (a << 1) | carry);
+                        this->WriteRegister8<Hooks>(CPU::RegisterA, (a << 1) | carry);
 
                         break;
                     }
@@ -436,10 +552,10 @@ namespace Emu8080
                         // rar
 
                         bool carry = this->GetFlag(CPU::Flag::C);
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
                         this->SetFlag(CPU::Flag::C, a & 1);
-                        this->WriteRegister8(CPU::RegisterA, (a >> 1) | (carry << 7));
+                        this->WriteRegister8<Hooks>(CPU::RegisterA, (a >> 1) | (carry << 7));
 
                         break;
                     }
@@ -447,21 +563,21 @@ namespace Emu8080
                     case 0b100: {
                         // daa
 
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
+                        bool carry = this->GetFlag(CPU::Flag::C);
+                        uint8_t correction = 0;
 
-                        if ((a & 0xF) > 0x9 || this->GetFlag(CPU::Flag::A)) {
-                            this->SetFlag(CPU::Flag::A, (a & 0xF) + 0x6 >= 0x10);
-                            a += 0x6;
-                        }
+                        if ((a & 0xF) > 0x9 || this->GetFlag(CPU::Flag::A))
+                            correction |= 0x06;
 
-                        if ((a >> 4) > 0x9 || this->GetFlag(CPU::Flag::C)) {
-                            if ((a >> 4) + 0x6 >= 0x10)
-                                this->SetFlag(CPU::Flag::C, 1);
-                            a += 0x60;
+                        if ((a >> 4) > 0x9 || carry || ((a >> 4) >= 0x9 && (a & 0xF) > 0x9)) {
+                            correction |= 0x60;
+                            carry = true;
                         }
 
-                        this->WriteRegister8(CPU::RegisterA, a);
-                        this->CalculateSZP(a);
+                        // The correction is a plain add, except that carry is never cleared.
+                        this->Add(correction);
+                        this->SetFlag(CPU::Flag::C, carry);
 
                         break;
                     }
@@ -469,8 +585,8 @@ namespace Emu8080
                     case 0b101: {
                         // cma
 
-                        uint8_t a = this->ReadRegister8(CPU::RegisterA);
-                        this->WriteRegister8(CPU::RegisterA, ~a);
+                        uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
+                        this->WriteRegister8<Hooks>(CPU::RegisterA, ~a);
 
                         break;
                     }
@@ -507,10 +623,10 @@ namespace Emu8080
                             uint16_t pc = this->ReadPC();
                             this->WritePC(pc + 2);
 
-                            uint16_t addr = this->Read16(pc);
-                            uint8_t value = this->Read8(addr);
+                            uint16_t addr = this->Read16<Hooks>(pc);
+                            uint8_t value = this->Read8<Hooks>(addr);
 
-                            this->WriteRegister8(CPU::RegisterA, value);
+                            this->WriteRegister8<Hooks>(CPU::RegisterA, value);
 
                             return 13;
                         }
@@ -521,8 +637,8 @@ namespace Emu8080
                             uint16_t pc = this->ReadPC();
                             this->WritePC(pc + 2);
 
-                            uint16_t addr = this->Read16(pc);
-                            uint16_t value = this->Read16(addr);
+                            uint16_t addr = this->Read16<Hooks>(pc);
+                            uint16_t value = this->Read16<Hooks>(addr);
 
                             this->WriteRegister16(CPU::RegisterPairHL, value);
 
@@ -533,9 +649,9 @@ namespace Emu8080
                             // ldax rp
                             
                             uint16_t addr = this->ReadRegister16(rp);
-                            uint8_t value = this->Read8(addr);
+                            uint8_t value = this->Read8<Hooks>(addr);
 
-                            this->WriteRegister8(CPU::RegisterA, value);
+                            this->WriteRegister8<Hooks>(CPU::RegisterA, value);
 
                             return 7;
                         }
@@ -548,10 +664,10 @@ namespace Emu8080
                             uint16_t pc = this->ReadPC();
                             this->WritePC(pc + 2);
 
-                            uint16_t addr = this->Read16(pc);
-                            uint8_t value = this->ReadRegister8(CPU::RegisterA);
+                            uint16_t addr = this->Read16<Hooks>(pc);
+                            uint8_t value = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
-                            this->Write8(addr, value);
+                            this->Write8<Hooks>(addr, value);
 
                             return 13;
                         }
@@ -562,10 +678,10 @@ namespace Emu8080
                             uint16_t pc = this->ReadPC();
                             this->WritePC(pc + 2);
 
-                            uint16_t addr = this->Read16(pc);
+                            uint16_t addr = this->Read16<Hooks>(pc);
                             uint16_t value = this->ReadRegister16(CPU::RegisterPairHL);
 
-                            this->Write16(addr, value);
+                            this->Write16<Hooks>(addr, value);
 
                             return 16;
                         }
@@ -574,9 +690,9 @@ namespace Emu8080
                             // stax rp
                             
                             uint16_t addr = this->ReadRegister16(rp);
-                            uint8_t value = this->ReadRegister8(CPU::RegisterA);
+                            uint8_t value = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
-                            this->Write8(addr, value);
+                            this->Write8<Hooks>(addr, value);
 
                             return 7;
                         }
@@ -604,7 +720,7 @@ namespace Emu8080
                     this->WritePC(pc + 2);
 
                     uint8_t rp = ExtractBits8(instruction, 5, 2);
-                    uint16_t value = this->Read16(pc);
+                    uint16_t value = this->Read16<Hooks>(pc);
 
                     this->WriteRegister16(rp, value);
 
@@ -619,23 +735,23 @@ namespace Emu8080
                 if (opcode == 0b00) {
                     // inr d
 
-                    uint8_t value = this->ReadRegister8(dest);
+                    uint8_t value = this->ReadRegister8<Hooks>(dest);
                     this->SetFlag(CPU::Flag::A, (value & 0xF) == 0xF);
 
                     value++;
 
-                    this->WriteRegister8(dest, value);
+                    this->WriteRegister8<Hooks>(dest, value);
                     this->CalculateSZP(value);
 
                     return dest == 0b110 ? 10 : 5;
                 } else if (opcode == 0b01) {
                     // dcr d
 
-                    uint8_t value = this->ReadRegister8(dest);
+                    uint8_t value = this->ReadRegister8<Hooks>(dest);
                     value--;
 
-                    this->SetFlag(CPU::Flag::A, (value & 0xF) == 0xF);
-                    this->WriteRegister8(dest, value);
+                    this->SetFlag(CPU::Flag::A, (value & 0xF) != 0xF);
+                    this->WriteRegister8<Hooks>(dest, value);
                     this->CalculateSZP(value);
 
                     return dest == 0b110 ? 10 : 5;
@@ -673,16 +789,16 @@ namespace Emu8080
 
             uint8_t dest = ExtractBits8(instruction, 4, 3);
             uint8_t source = ExtractBits8(instruction, 1, 3);
-            uint8_t value = this->ReadRegister8(source);
+            uint8_t value = this->ReadRegister8<Hooks>(source);
 
-            this->WriteRegister8(dest, value);
+            this->WriteRegister8<Hooks>(dest, value);
             return (dest == 0b110 || source == 0b110) ? 7 : 5;
         } else if (field == 0b10) {
             // add s, adc s, sub s, sbc s, ana s, ora s, xra s, cmp s
 
             uint8_t opcode = ExtractBits8(instruction, 4, 3);
             uint8_t source = ExtractBits8(instruction, 1, 3);
-            uint8_t value = this->ReadRegister8(source);
+            uint8_t value = this->ReadRegister8<Hooks>(source);
 
             this->Arithmetic(opcode, value);
 
@@ -692,7 +808,7 @@ namespace Emu8080
                 // jmp addr
 
                 uint16_t pc = this->ReadPC();
-                uint16_t addr = this->Read16(pc);
+                uint16_t addr = this->Read16<Hooks>(pc);
                 this->WritePC(addr);
 
                 return 10;
@@ -720,9 +836,9 @@ namespace Emu8080
                 // xthl
 
                 uint16_t hl = this->ReadRegister16(CPU::RegisterPairHL);
-                uint16_t addr = this->Pop();
+                uint16_t addr = this->Pop<Hooks>();
 
-                this->Push(hl);
+                this->Push<Hooks>(hl);
                 this->WriteRegister16(CPU::RegisterPairHL, addr);
 
                 return 18;
@@ -764,10 +880,10 @@ namespace Emu8080
                 uint16_t pc = this->ReadPC();
                 this->WritePC(pc + 1);
 
-                uint8_t port = this->Read8(pc);
+                uint8_t port = this->Read8<Hooks>(pc);
                 uint8_t value = this->InputData(port);
 
-                this->WriteRegister8(CPU::RegisterA, value);
+                this->WriteRegister8<Hooks>(CPU::RegisterA, value);
                 return 10;
             }
 
@@ -777,8 +893,8 @@ namespace Emu8080
                 uint16_t pc = this->ReadPC();
                 this->WritePC(pc + 1);
 
-                uint8_t port = this->Read8(pc);
-                uint8_t a = this->ReadRegister8(CPU::RegisterA);
+                uint8_t port = this->Read8<Hooks>(pc);
+                uint8_t a = this->ReadRegister8<Hooks>(CPU::RegisterA);
 
                 this->OutputData(port, a);
                 return 10;
@@ -787,7 +903,7 @@ namespace Emu8080
             if (instruction == 0b11001001 || instruction == 0b11011001) {
                 // ret
 
-                this->Return();
+                this->Return<Hooks>();
                 return 10;
             }
 
@@ -797,7 +913,7 @@ namespace Emu8080
                 // pop rp
 
                 uint8_t rp = ExtractBits8(instruction, 5, 2);
-                uint16_t value = this->Pop();
+                uint16_t value = this->Pop<Hooks>();
 
                 this->WriteRegister16(rp, value, false);
                 return 10;
@@ -809,7 +925,7 @@ namespace Emu8080
                 uint8_t rp = ExtractBits8(instruction, 5, 2);
                 uint16_t value = this->ReadRegister16(rp, false);
 
-                this->Push(value);
+                this->Push<Hooks>(value);
                 return 11;
             }
 
@@ -820,7 +936,7 @@ namespace Emu8080
                 this->WritePC(pc + 1);
 
                 uint8_t opcode = ExtractBits8(instruction, 4, 3);
-                uint8_t value = this->Read8(pc);
+                uint8_t value = this->Read8<Hooks>(pc);
 
                 this->Arithmetic(opcode, value);
                 return 7;
@@ -832,8 +948,8 @@ namespace Emu8080
                 uint16_t pc = this->ReadPC();
                 this->WritePC(pc + 2);
 
-                uint16_t addr = this->Read16(pc);
-                this->Call(addr);
+                uint16_t addr = this->Read16<Hooks>(pc);
+                this->Call<Hooks>(addr);
 
                 return 17;
             }
@@ -845,7 +961,7 @@ namespace Emu8080
                 this->WritePC(pc + 1);
 
                 uint8_t opcode = ExtractBits8(instruction, 4, 3);
-                uint8_t value = this->Read8(pc);
+                uint8_t value = this->Read8<Hooks>(pc);
 
                 this->Arithmetic(opcode, value);
                 return 7;
@@ -860,7 +976,7 @@ namespace Emu8080
                 bool ret = this->ConditionMet(condition);
 
                 if (ret)
-                    this->Return();
+                    this->Return<Hooks>();
 
                 return ret ? 11 : 5;
             }
@@ -874,7 +990,7 @@ namespace Emu8080
                 uint8_t cond = ExtractBits8(instruction, 4, 3);
 
                 if (this->ConditionMet(cond)) {
-                    uint16_t addr = this->Read16(pc);
+                    uint16_t addr = this->Read16<Hooks>(pc);
                     this->WritePC(addr);
                 }
 
@@ -890,8 +1006,8 @@ namespace Emu8080
                 uint8_t cond = ExtractBits8(instruction, 4, 3);
 
                 if (this->ConditionMet(cond)) {
-                    uint16_t addr = this->Read16(pc);
-                    this->Call(addr);
+                    uint16_t addr = this->Read16<Hooks>(pc);
+                    this->Call<Hooks>(addr);
                     return 17;
                 }
 
@@ -902,7 +1018,7 @@ namespace Emu8080
                 // rst 0-8
 
                 uint8_t n = ExtractBits8(instruction, 4, 3);
-                this->Call(n * 8);
+                this->Call<Hooks>(n * 8);
 
                 return 11;
             }
@@ -911,6 +1027,7 @@ namespace Emu8080
         throw std::runtime_error(FormatString("Unknown instruction 0x%x.", instruction));
     }
 
+    template<typename Hooks>
     void CPU::Push(uint16_t value)
     {
         uint16_t sp = this->ReadSP();
@@ -918,19 +1035,22 @@ namespace Emu8080
         uint8_t hi = value >> 8;
         uint8_t lo = value & 0xFF;
 
-        this->Write8(sp - 1, hi);
-        this->Write8(sp - 2, lo);
+        this->Write8<Hooks>(sp - 1, hi);
+        this->Write8<Hooks>(sp - 2, lo);
         this->WriteSP(sp - 2);
 
         this->Log("Pushed 0x%04x to stack.", value);
     }
 
+    void CPU::Push(uint16_t value) { this->Push<AllHooks>(value); }
+
+    template<typename Hooks>
     uint16_t CPU::Pop()
     {
         uint16_t sp = this->ReadSP();
 
-        uint8_t hi = this->Read8(sp + 1);
-        uint8_t lo = this->Read8(sp);
+        uint8_t hi = this->Read8<Hooks>(sp + 1);
+        uint8_t lo = this->Read8<Hooks>(sp);
         this->WriteSP(sp + 2);
 
         uint16_t value = (hi << 8) | lo;
@@ -939,55 +1059,100 @@ namespace Emu8080
         return value;
     }
 
+    uint16_t CPU::Pop() { return this->Pop<AllHooks>(); }
+
+    template<typename Hooks>
     void CPU::Call(uint16_t addr)
     {
         uint16_t pc = this->ReadPC();
-        this->Push(pc);
+        this->Push<Hooks>(pc);
         this->WritePC(addr);
 
+        Hooks::OnCall(this, addr, pc);
         this->Log("Called subroutine at addr 0x%04x (return to 0x%04x).", addr, pc);
     }
 
+    void CPU::Call(uint16_t addr) { this->Call<AllHooks>(addr); }
+
+    template<typename Hooks>
     void CPU::Return()
     {
-        uint16_t addr = this->Pop();
+        uint16_t addr = this->Pop<Hooks>();
         this->WritePC(addr);
 
+        Hooks::OnReturn(this, addr);
         this->Log("Returned from subroutine to addr 0x%04x.", addr);
     }
 
+    void CPU::Return() { this->Return<AllHooks>(); }
+
     bool CPU::GetInteruptsEnabled() const
     {
         return this->state->GetInteruptsEnabled();
     }
 
-    void CPU::OutputData(uint8_t port, uint8_t data) const
+    bool CPU::Interrupt(uint8_t vector)
+    {
+        if (!this->state->GetInteruptsEnabled())
+            return false;
+
+        // Acknowledging an interrupt clears INTE and wakes the CPU from hlt, then executes rst n.
+        this->state->SetInterruptsEnabled(false);
+        this->state->SetHalt(false);
+        this->Call((vector & 0b111) * 8);
+        this->state->SetWaitCycles(11);
+
+        this->Log("Serviced interrupt rst %d.", vector & 0b111);
+        return true;
+    }
+
+    void CPU::SetIODelegate(IODelegate * const delegate) { this->ioDelegate = delegate; }
+
+    IODelegate * const CPU::GetIODelegate() const { return this->ioDelegate; }
+
+    void CPU::OutputData(uint8_t port, uint8_t data)
     {
-        throw std::runtime_error("no I/O.");
+        if (this->ioDelegate == nullptr)
+            throw std::runtime_error("no I/O.");
+
+        this->ioDelegate->HandleOutput(this->state, port, data);
+        this->outputCount++;
 
         this->Log("Output 0x%x to port %x.", data, port);
     }
 
     uint8_t CPU::InputData(uint8_t port)
     {
-        throw std::runtime_error("no I/O.");
+        if (this->ioDelegate == nullptr)
+            throw std::runtime_error("no I/O.");
 
-        uint8_t data = 0;
+        uint8_t data = this->ioDelegate->HandleInput(this->state, port);
+        this->inputCount++;
 
         this->Log("Input 0x%x from port 0x%x.", data, port);
         return data;
     }
 
+    uint64_t CPU::GetInputCount() const { return this->inputCount; }
+
+    uint64_t CPU::GetOutputCount() const { return this->outputCount; }
+
+    void CPU::ResetIOCounts()
+    {
+        this->inputCount = 0;
+        this->outputCount = 0;
+    }
+
     void CPU::Arithmetic(uint8_t opcode, uint8_t value)
     {
         if (opcode == 0b000)
             this->Add(value);
         else if (opcode == 0b001)
-            this->Add(value + this->GetFlag(CPU::Flag::C));
+            this->Adc(value);
         else if (opcode == 0b010)
             this->Sub(value);
         else if (opcode == 0b011)
-            this->Sub(value + this->GetFlag(CPU::Flag::C));
+            this->Sbc(value);
         else if (opcode == 0b100)
             this->And(value);
         else if (opcode == 0b101)
@@ -1010,6 +1175,21 @@ namespace Emu8080
         this->SetFlag(CPU::Flag::A, (a & 0xF) + (value & 0xF) > 0xF);
     }
 
+    void CPU::Adc(uint8_t value)
+    {
+        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+        bool carry = this->GetFlag(CPU::Flag::C);
+        uint16_t sum = a + value + carry;
+
+        this->WriteRegister8(CPU::RegisterA, sum);
+        this->CalculateSZP(sum);
+
+        this->SetFlag(CPU::Flag::C, sum > 0xFF);
+        this->SetFlag(CPU::Flag::A, (a & 0xF) + (value & 0xF) + carry > 0xF);
+    }
+
+    // The 8080 subtracts by adding the complement, so the auxiliary carry is the carry out of
+    // bit 3 of a + ~value + 1, not a borrow.
     void CPU::Sub(uint8_t value)
     {
         uint8_t a = this->ReadRegister8(CPU::RegisterA);
@@ -1019,7 +1199,20 @@ namespace Emu8080
         this->CalculateSZP(sum);
 
         this->SetFlag(CPU::Flag::C, value > a);
-        this->SetFlag(CPU::Flag::A, (a & 0xF) > (value & 0xF));
+        this->SetFlag(CPU::Flag::A, (a & 0xF) + (~value & 0xF) + 1 > 0xF);
+    }
+
+    void CPU::Sbc(uint8_t value)
+    {
+        uint8_t a = this->ReadRegister8(CPU::RegisterA);
+        bool borrow = this->GetFlag(CPU::Flag::C);
+        uint16_t sum = a - value - borrow;
+
+        this->WriteRegister8(CPU::RegisterA, sum);
+        this->CalculateSZP(sum);
+
+        this->SetFlag(CPU::Flag::C, value + borrow > a);
+        this->SetFlag(CPU::Flag::A, (a & 0xF) + (~value & 0xF) + !borrow > 0xF);
     }
 
     void CPU::And(uint8_t value)
@@ -1031,7 +1224,7 @@ namespace Emu8080
         this->CalculateSZP(n);
 
         this->SetFlag(CPU::Flag::C, 0);
-        // this->SetFlag(CPU::Flag::A, 0);
+        this->SetFlag(CPU::Flag::A, ((a | value) & 0x08) != 0);
     }
 
     void CPU::Or(uint8_t value)
@@ -1065,6 +1258,11 @@ namespace Emu8080
         this->CalculateSZP(sum);
 
         this->SetFlag(CPU::Flag::C, value > a);
-        this->SetFlag(CPU::Flag::A, (a & 0xF) > (value & 0xF));
+        this->SetFlag(CPU::Flag::A, (a & 0xF) + (~value & 0xF) + 1 > 0xF);
     }
+
+    template uint8_t CPU::ExecuteInstruction<NoHooks>();
+    template uint8_t CPU::ExecuteInstruction<ExecutionHooks>();
+    template uint8_t CPU::ExecuteInstruction<WriteHooks>();
+    template uint8_t CPU::ExecuteInstruction<AllHooks>();
 }
\ No newline at end of file
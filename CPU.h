@@ -2,36 +2,58 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "CPUState.h"
+#include "CPUHooks.h"
+#include "CPUDelegate.h"
+#include "IODelegate.h"
+#include "FlightRecorder.h"
 
 namespace Emu8080
 {
-    class CPU {
+    // Constants and enumerations.
+    struct CPUBase {
+        // Constants
+        static const uint8_t RegisterA = 0b111;
+        static const uint8_t RegisterB = 0b000;
+        static const uint8_t RegisterC = 0b001;
+        static const uint8_t RegisterD = 0b010;
+        static const uint8_t RegisterE = 0b011;
+        static const uint8_t RegisterH = 0b100;
+        static const uint8_t RegisterL = 0b101;
+        static const uint8_t RegisterM = 0b110;
+
+        static const uint8_t RegisterPairBC = 0b00;
+        static const uint8_t RegisterPairDE = 0b01;
+        static const uint8_t RegisterPairHL = 0b10;
+        static const uint8_t RegisterPairSP = 0b11;
+        static const uint8_t RegisterPairPSW = 0b11;
+
+        // Enumerations
+        enum class Flag { S = 7, Z = 6, A = 4, P = 2, C = 0 };
+    };
+
+    // Execution functions are templates on a hooks policy (see CPUHooks.h), so one CPU can run bare or
+    // instrumented. The untemplated functions pick the policy from the hooks its delegates asked for.
+    class CPU : public CPUBase {
         private:
             void (*logFunction)(const std::string &);
             CPUState *state;
 
-        public:
-            // Constants
-            static const uint8_t RegisterA = 0b111;
-            static const uint8_t RegisterB = 0b000;
-            static const uint8_t RegisterC = 0b001;
-            static const uint8_t RegisterD = 0b010;
-            static const uint8_t RegisterE = 0b011;
-            static const uint8_t RegisterH = 0b100;
-            static const uint8_t RegisterL = 0b101;
-            static const uint8_t RegisterM = 0b110;
-
-            static const uint8_t RegisterPairBC = 0b00;
-            static const uint8_t RegisterPairDE = 0b01;
-            static const uint8_t RegisterPairHL = 0b10;
-            static const uint8_t RegisterPairSP = 0b11;
-            static const uint8_t RegisterPairPSW = 0b11;
-
-            // Enumerations
-            enum class Flag { S = 7, Z = 6, A = 4, P = 2, C = 0 };
+            std::vector<CPUDelegate *> delegates;
+            std::vector<CPUDelegate *> hookDelegates[CPUHookCount];
+            uint32_t hooks;
+            IODelegate *ioDelegate;
+
+            uint64_t inputCount;
+            uint64_t outputCount;
+
+            FlightRecorder flightRecorder;
 
+            template<typename Hooks> uint8_t Dispatch(uint16_t pc, uint8_t instruction);
+
+        public:
             // Constructor/destructor
             CPU(void (*logFunction)(const std::string &), uint32_t memorySize);
             ~CPU();
@@ -44,15 +66,26 @@ namespace Emu8080
             CPUState * const GetState();
             void SetState(const CPUState * const state);
 
+            // Delegates; each is only called for the hooks it returns from GetHooks when it is added.
+            void AddDelegate(CPUDelegate * const delegate);
+            void RemoveDelegate(CPUDelegate * const delegate);
+            const std::vector<CPUDelegate *> &GetDelegates() const;
+            const std::vector<CPUDelegate *> &GetDelegates(CPUHook hook) const;
+            uint32_t GetHooks() const;
+
             // Log
-            template<typename ... Args> void Log(const std::string &format, Args ... args) const;
+            template<typename ... Args> void Log(const char * const format, Args ... args) const;
 
             // Memory write
+            template<typename Hooks> void Write8(uint16_t addr, uint8_t value);
+            template<typename Hooks> void Write16(uint16_t addr, uint16_t value);
             void Write8(uint16_t addr, uint8_t value);
             void Write16(uint16_t addr, uint16_t value);
             void WriteBytes(uint16_t addr, const uint8_t * const bytes, uint16_t size);
 
             // Memory read
+            template<typename Hooks> uint8_t Read8(uint16_t addr) const;
+            template<typename Hooks> uint16_t Read16(uint16_t addr) const;
             uint8_t Read8(uint16_t addr) const;
             uint16_t Read16(uint16_t addr) const;
             void ReadBytes(uint16_t addr, void * const buffer, uint16_t size) const;
@@ -60,12 +93,14 @@ namespace Emu8080
             // Register write
             void WritePC(uint16_t pc);
             void WriteSP(uint16_t sp);
+            template<typename Hooks> void WriteRegister8(uint8_t r, uint8_t value);
             void WriteRegister8(uint8_t r, uint8_t value);
             void WriteRegister16(uint8_t r, uint16_t value, bool spAvailable = true);
 
             // Register read
             uint16_t ReadPC() const;
             uint16_t ReadSP() const;
+            template<typename Hooks> uint8_t ReadRegister8(uint8_t r) const;
             uint8_t ReadRegister8(uint8_t r) const;
             uint16_t ReadRegister16(uint8_t r, bool spAvailable = true) const;
             
@@ -78,19 +113,31 @@ namespace Emu8080
             // Execution
             void ExecuteCycle();
             uint8_t ExecuteInstruction();
+            template<typename Hooks> uint8_t ExecuteInstruction();
+            const FlightRecorder &GetFlightRecorder() const;
 
             // Stack
+            template<typename Hooks> void Push(uint16_t addr);
+            template<typename Hooks> uint16_t Pop();
             void Push(uint16_t addr);
             uint16_t Pop();
 
             // Control flow
+            template<typename Hooks> void Call(uint16_t addr);
+            template<typename Hooks> void Return();
             void Call(uint16_t addr);
             void Return();
             bool GetInteruptsEnabled() const;
+            bool Interrupt(uint8_t vector);
 
             // I/O
-            void OutputData(uint8_t port, uint8_t data) const;
+            void SetIODelegate(IODelegate * const delegate);
+            IODelegate * const GetIODelegate() const;
+            void OutputData(uint8_t port, uint8_t data);
             uint8_t InputData(uint8_t port);
+            uint64_t GetInputCount() const;
+            uint64_t GetOutputCount() const;
+            void ResetIOCounts();
 
             // Arithmetic
             void Arithmetic(uint8_t opcode, uint8_t value);
@@ -115,4 +162,64 @@ namespace Emu8080
     uint8_t Register8ForString(const std::string &str);
     uint8_t Register16ForString(const std::string &str);
     CPU::Flag FlagForString(const std::string &str);
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnFetch(CPUType * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        if (Mask & HookFetch) {
+            for (auto delegate : cpu->GetDelegates(HookFetch))
+                delegate->WillExecuteInstruction(cpu, pc, opcode);
+        }
+    }
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnRetire(CPUType * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        if (Mask & HookRetire) {
+            for (auto delegate : cpu->GetDelegates(HookRetire))
+                delegate->DidExecuteInstruction(cpu, pc, opcode, cycles);
+        }
+    }
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnRead(const CPUType * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (Mask & HookRead) {
+            for (auto delegate : cpu->GetDelegates(HookRead))
+                delegate->DidReadMemory(cpu, addr, value);
+        }
+    }
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnWrite(CPUType * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (Mask & HookWrite) {
+            for (auto delegate : cpu->GetDelegates(HookWrite))
+                delegate->WillWriteMemory(cpu, addr, value);
+        }
+    }
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnCall(CPUType * const cpu, uint16_t addr, uint16_t returnAddress)
+    {
+        if (Mask & HookCall) {
+            for (auto delegate : cpu->GetDelegates(HookCall))
+                delegate->DidCall(cpu, addr, returnAddress);
+        }
+    }
+
+    template<uint32_t Mask>
+    template<typename CPUType>
+    void DelegateHooks<Mask>::OnReturn(CPUType * const cpu, uint16_t addr)
+    {
+        if (Mask & HookCall) {
+            for (auto delegate : cpu->GetDelegates(HookCall))
+                delegate->DidReturn(cpu, addr);
+        }
+    }
 }
\ No newline at end of file
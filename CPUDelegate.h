@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "CPUHooks.h"
+
+namespace Emu8080
+{
+    class CPUDelegate {
+        public:
+            virtual ~CPUDelegate() {}
+
+            // The CPUHook bits this delegate wants; the CPU reads it once, in AddDelegate, and never calls the others.
+            virtual uint32_t GetHooks() const { return HookAll; }
+
+            virtual void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) {}
+            virtual void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) {}
+            virtual void DidReadMemory(const CPU * const cpu, uint16_t addr, uint8_t value) {}
+            virtual void WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value) {}
+
+            // Called from CPU::Call and CPU::Return, so rst, conditional calls/returns and interrupts are included.
+            virtual void DidCall(CPU * const cpu, uint16_t addr, uint16_t returnAddress) {}
+            virtual void DidReturn(CPU * const cpu, uint16_t addr) {}
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Emu8080
+{
+    class CPU;
+
+    // The hooks a CPUDelegate can ask for, as bits of CPUDelegate::GetHooks(). DidCall and DidReturn share HookCall.
+    enum CPUHook : uint32_t {
+        HookFetch = 1 << 0,
+        HookRetire = 1 << 1,
+        HookRead = 1 << 2,
+        HookWrite = 1 << 3,
+        HookCall = 1 << 4,
+        HookAll = (1 << 5) - 1
+    };
+
+    static const int CPUHookCount = 5;
+
+    // Compile-time instrumentation for the CPU's execution functions, which are templates on a policy. The core
+    // calls each hook at a fixed point: OnFetch before an instruction executes, OnRetire after, OnRead/OnWrite
+    // around guest memory accesses (OnWrite before the byte changes), OnCall/OnReturn from Call and Return. Every
+    // hook here is an empty inline function, so NoHooks compiles to the bare interpreter. Policies derive from
+    // NoHooks and hide only the hooks they need; CPU::ExecuteInstruction<Policy> runs one instruction under a
+    // policy, and needs an explicit instantiation next to the others in CPU.cpp.
+    struct NoHooks {
+        template<typename CPUType> static void OnFetch(CPUType * const cpu, uint16_t pc, uint8_t opcode) {}
+        template<typename CPUType> static void OnRetire(CPUType * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) {}
+        template<typename CPUType> static void OnRead(const CPUType * const cpu, uint16_t addr, uint8_t value) {}
+        template<typename CPUType> static void OnWrite(CPUType * const cpu, uint16_t addr, uint8_t value) {}
+        template<typename CPUType> static void OnCall(CPUType * const cpu, uint16_t addr, uint16_t returnAddress) {}
+        template<typename CPUType> static void OnReturn(CPUType * const cpu, uint16_t addr) {}
+    };
+
+    // Forwards the hooks in Mask to the CPUDelegates that asked for each one; the rest compile away as in NoHooks.
+    template<uint32_t Mask>
+    struct DelegateHooks : public NoHooks {
+        template<typename CPUType> static void OnFetch(CPUType * const cpu, uint16_t pc, uint8_t opcode);
+        template<typename CPUType> static void OnRetire(CPUType * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles);
+        template<typename CPUType> static void OnRead(const CPUType * const cpu, uint16_t addr, uint8_t value);
+        template<typename CPUType> static void OnWrite(CPUType * const cpu, uint16_t addr, uint8_t value);
+        template<typename CPUType> static void OnCall(CPUType * const cpu, uint16_t addr, uint16_t returnAddress);
+        template<typename CPUType> static void OnReturn(CPUType * const cpu, uint16_t addr);
+    };
+
+    // The tiers CPU::ExecuteInstruction picks from. Memory hooks run on every access, so they are only compiled in
+    // when an attached delegate asked for them; the per-instruction hooks are cheap enough to share one tier.
+    typedef DelegateHooks<HookFetch | HookRetire | HookCall> ExecutionHooks;
+    typedef DelegateHooks<HookFetch | HookRetire | HookCall | HookWrite> WriteHooks;
+    typedef DelegateHooks<HookAll> AllHooks;
+}
@@ -1,30 +1,93 @@
 #include "CPUState.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Util.h"
+#include "PageStore.h"
 
 namespace Emu8080
 {
+    // Save state files hold a fixed-size header followed by the raw memory image. The image starts
+    // on a page boundary so it can be mapped copy-on-write and shared between processes.
+    static const char SaveStateMagic[4] = { 'E', '8', '0', 'S' };
+    static const uint32_t SaveStateVersion = 1;
+    static const size_t SaveStateMemoryOffset = 0x1000;
+
+    // Each run of consecutive page store slots costs a shared state one mapping, and the process may only hold
+    // vm.max_map_count of those (65530 by default). Capping the runs keeps 10k shared states under it.
+    static const size_t MaxSharedMappings = 4;
+
+    struct SaveStateHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t memorySize;
+        uint16_t pc;
+        uint16_t sp;
+        uint8_t registers[7];
+        uint8_t flags;
+        uint8_t waitCycles;
+        uint8_t halt;
+        uint8_t interuptsEnabled;
+    };
+
+    const uint32_t CPUState::PageSize;
+
     CPUState::CPUState()
     {
         this->memory = nullptr;
         this->memorySize = 0;
 
+        this->mapping = nullptr;
+        this->mappingSize = 0;
+
+        this->pageStore = nullptr;
+
         this->halt = false;
         this->interuptsEnabled = false;
 
         this->flags = 0x2;
 
         this->waitCycles = 0;
+
+        this->ResetPageHashes();
     }
 
     CPUState::~CPUState()
     {
-        if (this->memory != nullptr)
-            free((void *)this->memory);
+        this->ReleaseMemory();
     }
 
-    bool CPUState::IsEqual(const CPUState * const state, bool compareRAM)
+    void CPUState::ReleaseMemory()
+    {
+        if (this->mapping != nullptr) {
+            munmap(this->mapping, this->mappingSize);
+
+            this->mapping = nullptr;
+            this->mappingSize = 0;
+
+            if (this->pageStore != nullptr) {
+                for (auto slot : this->sharedSlots)
+                    this->pageStore->Release(slot);
+
+                this->sharedSlots.clear();
+                this->pageStore = nullptr;
+            }
+        } else if (this->memory != nullptr) {
+            free(this->memory);
+        }
+
+        this->memory = nullptr;
+    }
+
+    bool CPUState::IsEqual(const CPUState * const state, bool compareRAM) const
     {
         if (this->memorySize != state->memorySize)
             return false;
@@ -47,26 +110,61 @@ namespace Emu8080
         if (compareRAM) {
             if (this->memory == nullptr || state->memory == nullptr)
                 return false;
-            if (std::memcmp(this->memory, state->memory, this->memorySize) != 0)
+            // The digests only reject cheaply; equal digests still need the bytes compared.
+            if (this->GetMemoryDigest() != state->GetMemoryDigest())
+                return false;
+            if (memcmp(this->memory, state->memory, this->memorySize) != 0)
                 return false;
         }
 
         return true;
     }
 
+    void CPUState::Diff(const CPUState * const state, StateDiff * const diff, bool compareRAM, uint32_t mergeGap) const
+    {
+        diff->Clear();
+
+        if (this->pc != state->pc)
+            diff->fields |= StateDiff::PC;
+        if (this->sp != state->sp)
+            diff->fields |= StateDiff::SP;
+        if (this->flags != state->flags)
+            diff->fields |= StateDiff::Flags;
+        if (this->halt != state->halt)
+            diff->fields |= StateDiff::Halt;
+        if (this->interuptsEnabled != state->interuptsEnabled)
+            diff->fields |= StateDiff::InterruptsEnabled;
+        if (this->memorySize != state->memorySize)
+            diff->fields |= StateDiff::MemorySize;
+
+        // registers[] is indexed a, b, c, d, e, h, l, matching the field bit order.
+        for (int i = 0; i < 7; i++) {
+            if (this->registers[i] != state->registers[i])
+                diff->fields |= StateDiff::A << i;
+        }
+
+        if (compareRAM && this->memory != nullptr && state->memory != nullptr)
+            FindMemoryDifferences(this->memory, state->memory, std::min(this->memorySize, state->memorySize), mergeGap, diff->ranges);
+    }
+
     void CPUState::CopyTo(CPUState * const state, bool copyMemory) const
     {
         if (copyMemory && this->memorySize > 0) {
-            if (state->memory != nullptr)
-                free(state->memory);
+            state->ReleaseMemory();
 
             state->memory = (uint8_t *)malloc(this->memorySize);
             state->memorySize = this->memorySize;
 
             memcpy(state->memory, this->memory, this->memorySize);
+
+            state->pageHashes = this->pageHashes;
+            state->dirtyPages = this->dirtyPages;
+            state->memoryDigest = this->memoryDigest;
+            state->anyDirty = this->anyDirty;
         } else {
             state->memory = nullptr;
             state->memorySize = 0;
+            state->ResetPageHashes();
         }
 
         state->pc = this->pc;
@@ -91,42 +189,63 @@ namespace Emu8080
 
     void CPUState::SetMemory(const uint8_t * const memory, const uint32_t size)
     {
-        if (this->memory != nullptr)
-            free(this->memory);
+        this->ReleaseMemory();
 
         this->memorySize = size;
         this->memory = (uint8_t *)malloc(size);
 
         memcpy(this->memory, memory, size);
+        this->ResetPageHashes();
     }
 
     void CPUState::SetMemorySize(uint32_t size)
     {
+        uint32_t oldSize = this->memorySize;
         this->memorySize = size;
 
         if (size == 0) {
-            if (this->memory != nullptr) {
-                free(this->memory);
-                this->memory = nullptr;
-            }
-
-            return;
+            this->ReleaseMemory();
+        } else if (this->mapping != nullptr) {
+            // Mapped memory can't be resized in place; move it to the heap.
+            uint8_t *memory = (uint8_t *)calloc(size, 1);
+            if (oldSize > 0)
+                memcpy(memory, this->memory, std::min(size, oldSize));
+
+            this->ReleaseMemory();
+            this->memory = memory;
         } else {
-            if (this->memory == nullptr)
-                this->memory = (uint8_t *)malloc(size);
-            else
+            // Fresh memory is zeroed so identical guests have identical (and shareable) pages.
+            if (this->memory == nullptr) {
+                this->memory = (uint8_t *)calloc(size, 1);
+            } else {
                 this->memory = (uint8_t *)realloc(this->memory, size);
+
+                if (size > oldSize)
+                    memset(this->memory + oldSize, 0, size - oldSize);
+            }
         }
+
+        this->ResetPageHashes();
     }
 
     void CPUState::WriteByte(uint16_t address, uint8_t value)
     {
         this->memory[address] = value;
+
+        this->dirtyPages[address / PageSize] = 1;
+        this->anyDirty = true;
     }
 
     void CPUState::WriteBytes(uint16_t address, const uint8_t * const bytes, uint32_t size)
     {
         memcpy(this->memory + address, bytes, size);
+
+        if (size > 0) {
+            for (uint32_t page = address / PageSize; page <= (address + size - 1) / PageSize; page++)
+                this->dirtyPages[page] = 1;
+
+            this->anyDirty = true;
+        }
     }
 
     uint16_t CPUState::GetPC() const
@@ -154,6 +273,11 @@ namespace Emu8080
         return this->registers[index];
     }
 
+    const uint8_t *CPUState::GetRegisters() const
+    {
+        return this->registers;
+    }
+
     void CPUState::SetRegister(uint8_t index, uint8_t value)
     {
         this->registers[index] = value;
@@ -198,4 +322,258 @@ namespace Emu8080
     {
         this->interuptsEnabled = enabled;
     }
+
+    void CPUState::SaveToFile(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "wb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        uint8_t page[SaveStateMemoryOffset] = { 0 };
+        SaveStateHeader *header = (SaveStateHeader *)page;
+
+        memcpy(header->magic, SaveStateMagic, sizeof(SaveStateMagic));
+        header->version = SaveStateVersion;
+        header->memorySize = this->memorySize;
+        header->pc = this->pc;
+        header->sp = this->sp;
+        memcpy(header->registers, this->registers, sizeof(this->registers));
+        header->flags = this->flags;
+        header->waitCycles = this->waitCycles;
+        header->halt = this->halt;
+        header->interuptsEnabled = this->interuptsEnabled;
+
+        bool ok = fwrite(page, 1, sizeof(page), file) == sizeof(page);
+
+        if (ok && this->memorySize > 0)
+            ok = fwrite(this->memory, 1, this->memorySize, file) == this->memorySize;
+
+        if (fclose(file) != 0)
+            ok = false;
+
+        if (!ok)
+            throw std::runtime_error(FormatString("Failed to write save state '%s'.", filename));
+    }
+
+    void CPUState::LoadFromFile(const char * const filename)
+    {
+        int fd = open(filename, O_RDONLY);
+
+        if (fd < 0)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < SaveStateMemoryOffset) {
+            close(fd);
+            throw std::runtime_error(FormatString("'%s' is not a valid save state.", filename));
+        }
+
+        // Private mapping: pages stay shared with the file (and every other instance mapping it)
+        // until the guest writes to them.
+        size_t size = st.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(FormatString("Failed to map save state '%s'.", filename));
+
+        const SaveStateHeader *header = (const SaveStateHeader *)mapping;
+
+        if (memcmp(header->magic, SaveStateMagic, sizeof(SaveStateMagic)) != 0 || header->version != SaveStateVersion
+         || header->memorySize > size - SaveStateMemoryOffset) {
+            munmap(mapping, size);
+            throw std::runtime_error(FormatString("'%s' is not a valid save state.", filename));
+        }
+
+        this->ReleaseMemory();
+
+        this->mapping = mapping;
+        this->mappingSize = size;
+        this->memory = header->memorySize > 0 ? (uint8_t *)mapping + SaveStateMemoryOffset : nullptr;
+        this->memorySize = header->memorySize;
+
+        this->pc = header->pc;
+        this->sp = header->sp;
+        memcpy(this->registers, header->registers, sizeof(this->registers));
+        this->flags = header->flags;
+        this->waitCycles = header->waitCycles;
+        this->halt = header->halt;
+        this->interuptsEnabled = header->interuptsEnabled;
+
+        this->ResetPageHashes();
+    }
+
+    bool CPUState::IsMemoryMapped() const
+    {
+        return this->mapping != nullptr;
+    }
+
+    void CPUState::ShareMemory(PageStore * const store)
+    {
+        size_t pageSize = store->GetPageSize();
+
+        if (this->memorySize == 0 || this->memorySize % pageSize != 0)
+            throw std::runtime_error(FormatString("Memory size (0x%x) must be a multiple of the host page size (0x%zx) to be shared.", this->memorySize, pageSize));
+
+        size_t pages = this->memorySize / pageSize;
+        std::vector<size_t> slots(pages);
+
+        size_t runs = 0;
+
+        for (size_t i = 0; i < pages; i++) {
+            slots[i] = store->Intern(this->memory + i * pageSize, i > 0 ? slots[i - 1] + 1 : PageStore::NoSlot);
+
+            if (i == 0 || slots[i] != slots[i - 1] + 1)
+                runs++;
+        }
+
+        // Too scattered to map cheaply, so map the image as one run, shared only with states holding the same image.
+        if (runs > MaxSharedMappings) {
+            for (auto slot : slots)
+                store->Release(slot);
+
+            size_t first = store->InternRun(this->memory, pages);
+
+            for (size_t i = 0; i < pages; i++)
+                slots[i] = first + i;
+        }
+
+        // Reserve the range first, then map each run of consecutive slots over it copy-on-write;
+        // the kernel copies a page the first time this state writes to it.
+        uint8_t *region = (uint8_t *)mmap(nullptr, this->memorySize, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        bool ok = region != MAP_FAILED;
+
+        for (size_t i = 0; ok && i < pages;) {
+            size_t run = 1;
+
+            while (i + run < pages && slots[i + run] == slots[i] + run)
+                run++;
+
+            void *page = mmap(region + i * pageSize, run * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                store->GetFileDescriptor(), store->GetSlotOffset(slots[i]));
+
+            ok = page != MAP_FAILED;
+            i += run;
+        }
+
+        if (!ok) {
+            int error = errno;
+
+            if (region != MAP_FAILED)
+                munmap(region, this->memorySize);
+
+            for (auto slot : slots)
+                store->Release(slot);
+
+            throw std::runtime_error(FormatString("Failed to map shared memory pages (%s); check vm.max_map_count.", strerror(error)));
+        }
+
+        // Contents are unchanged, so the page hashes stay valid.
+        this->ReleaseMemory();
+
+        this->memory = region;
+        this->mapping = region;
+        this->mappingSize = this->memorySize;
+
+        this->pageStore = store;
+        this->sharedSlots.swap(slots);
+    }
+
+    bool CPUState::IsMemoryShared() const
+    {
+        return this->pageStore != nullptr;
+    }
+
+    static inline uint64_t MixPageHash(uint32_t page, uint64_t hash)
+    {
+        uint64_t n = hash + (page + 1) * 0x9E3779B97F4A7C15ULL;
+
+        n = (n ^ (n >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        n = (n ^ (n >> 27)) * 0x94D049BB133111EBULL;
+
+        return n ^ (n >> 31);
+    }
+
+    void CPUState::ResetPageHashes()
+    {
+        uint32_t pages = (this->memorySize + PageSize - 1) / PageSize;
+
+        this->pageHashes.assign(pages, 0);
+        this->dirtyPages.assign(pages, 1);
+        this->anyDirty = pages > 0;
+
+        this->memoryDigest = 0;
+
+        for (uint32_t page = 0; page < pages; page++)
+            this->memoryDigest ^= MixPageHash(page, 0);
+    }
+
+    void CPUState::UpdatePageHashes() const
+    {
+        if (!this->anyDirty)
+            return;
+
+        uint32_t pages = this->pageHashes.size();
+
+        // The memory digest is an XOR of mixed page hashes, so a page can be swapped out of it in O(1).
+        for (uint32_t page = 0; page < pages; page++) {
+            if (this->dirtyPages[page] == 0)
+                continue;
+
+            uint32_t offset = page * PageSize;
+            uint64_t hash = HashBytes(this->memory + offset, std::min(PageSize, this->memorySize - offset));
+
+            this->memoryDigest ^= MixPageHash(page, this->pageHashes[page]) ^ MixPageHash(page, hash);
+            this->pageHashes[page] = hash;
+            this->dirtyPages[page] = 0;
+        }
+
+        this->anyDirty = false;
+    }
+
+    uint32_t CPUState::GetPageCount() const
+    {
+        return this->pageHashes.size();
+    }
+
+    uint64_t CPUState::GetPageHash(uint32_t page) const
+    {
+        if (page >= this->pageHashes.size())
+            throw std::runtime_error(FormatString("Page %u exceeds page count (%u).", page, (uint32_t)this->pageHashes.size()));
+
+        this->UpdatePageHashes();
+        return this->pageHashes[page];
+    }
+
+    uint64_t CPUState::GetMemoryDigest() const
+    {
+        this->UpdatePageHashes();
+        return this->memoryDigest;
+    }
+
+    uint64_t CPUState::GetDigest() const
+    {
+        uint8_t bytes[26];
+
+        bytes[0] = this->pc & 0xFF;
+        bytes[1] = this->pc >> 8;
+        bytes[2] = this->sp & 0xFF;
+        bytes[3] = this->sp >> 8;
+        memcpy(bytes + 4, this->registers, sizeof(this->registers));
+        bytes[11] = this->flags;
+        bytes[12] = this->halt;
+        bytes[13] = this->interuptsEnabled;
+
+        uint64_t memoryDigest = this->GetMemoryDigest();
+
+        for (int i = 0; i < 8; i++)
+            bytes[14 + i] = memoryDigest >> (i * 8);
+
+        for (int i = 0; i < 4; i++)
+            bytes[22 + i] = this->memorySize >> (i * 8);
+
+        return HashBytes(bytes, 26);
+    }
 }
\ No newline at end of file
@@ -1,14 +1,32 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "StateDiff.h"
 
 namespace Emu8080
 {
+    class PageStore;
+
     class CPUState {
         private:
             uint8_t *memory;
             uint32_t memorySize;
 
+            void *mapping;
+            size_t mappingSize;
+
+            PageStore *pageStore;
+            std::vector<size_t> sharedSlots;
+
+            // Page hashes are recomputed lazily; writes only mark their page dirty.
+            mutable std::vector<uint64_t> pageHashes;
+            mutable std::vector<uint8_t> dirtyPages;
+            mutable uint64_t memoryDigest;
+            mutable bool anyDirty;
+
             uint16_t pc;
             uint16_t sp;
 
@@ -21,11 +39,18 @@ namespace Emu8080
             bool halt;
             bool interuptsEnabled;
 
+            void ReleaseMemory();
+            void ResetPageHashes();
+            void UpdatePageHashes() const;
+
         public:
+            static const uint32_t PageSize = 0x100;
+
             CPUState();
             ~CPUState();
 
-            bool IsEqual(const CPUState * const state, bool compareRAM = true);
+            bool IsEqual(const CPUState * const state, bool compareRAM = true) const;
+            void Diff(const CPUState * const state, StateDiff * const diff, bool compareRAM = true, uint32_t mergeGap = 0) const;
             void CopyTo(CPUState * const state, bool copyMemory = true) const;
             
             const uint8_t *GetMemory() const;
@@ -43,6 +68,7 @@ namespace Emu8080
             void SetSP(uint16_t sp);
 
             uint8_t GetRegister(uint8_t index) const;
+            const uint8_t *GetRegisters() const;
             void SetRegister(uint8_t index, uint8_t value);
 
             uint8_t GetFlags() const;
@@ -56,5 +82,20 @@ namespace Emu8080
 
             void SetHalt(bool halt);
             void SetInterruptsEnabled(bool enabled);
+
+            // Save states
+            void SaveToFile(const char * const filename) const;
+            void LoadFromFile(const char * const filename);
+            bool IsMemoryMapped() const;
+
+            // Page sharing
+            void ShareMemory(PageStore * const store);
+            bool IsMemoryShared() const;
+
+            // Hashing
+            uint32_t GetPageCount() const;
+            uint64_t GetPageHash(uint32_t page) const;
+            uint64_t GetMemoryDigest() const;
+            uint64_t GetDigest() const;
     };
 }
\ No newline at end of file
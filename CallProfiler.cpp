@@ -0,0 +1,322 @@
+#include "CallProfiler.h"
+
+#include <algorithm>
+
+#include "CPU.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    static std::string RoutineName(int32_t routine, const SymbolMap * const symbols)
+    {
+        if (routine < 0)
+            return "[root]";
+
+        return symbols != nullptr ? symbols->Describe(routine) : FormatString("0x%04x", routine);
+    }
+
+    CallProfiler::CallProfiler(size_t maxDepth)
+    {
+        this->maxDepth = maxDepth > 0 ? maxDepth : 1;
+        this->Reset();
+    }
+
+    uint32_t CallProfiler::GetHooks() const { return HookFetch | HookRetire | HookCall; }
+
+    void CallProfiler::WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        this->executing = true;
+    }
+
+    // The instruction is charged to the routine it started in, so a call's cycles belong to the caller and a ret's to
+    // the callee. Stack changes are applied afterwards.
+    void CallProfiler::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        this->cycles += cycles;
+        this->nodes[this->frames.back().node].exclusiveCycles += cycles;
+
+        if (this->pendingReturn)
+            this->HandleReturn(this->returnSP);
+        if (this->pendingCall)
+            this->PushFrame(this->callAddress, this->callSP);
+
+        this->pendingCall = false;
+        this->pendingReturn = false;
+        this->executing = false;
+    }
+
+    void CallProfiler::DidCall(CPU * const cpu, uint16_t addr, uint16_t returnAddress)
+    {
+        uint16_t sp = cpu->GetState()->GetSP();
+
+        // Interrupts call outside of any instruction.
+        if (!this->executing) {
+            this->PushFrame(addr, sp);
+            return;
+        }
+
+        this->pendingCall = true;
+        this->callAddress = addr;
+        this->callSP = sp;
+    }
+
+    void CallProfiler::DidReturn(CPU * const cpu, uint16_t addr)
+    {
+        uint16_t sp = cpu->GetState()->GetSP() - 2;
+
+        if (!this->executing) {
+            this->HandleReturn(sp);
+            return;
+        }
+
+        this->pendingReturn = true;
+        this->returnSP = sp;
+    }
+
+    int32_t CallProfiler::GetChild(int32_t parent, int32_t routine)
+    {
+        auto key = std::make_pair(parent, routine);
+        auto it = this->children.find(key);
+
+        if (it != this->children.end())
+            return it->second;
+
+        Node node;
+        node.routine = routine;
+        node.parent = parent;
+        node.calls = 0;
+        node.exclusiveCycles = 0;
+        node.inclusiveCycles = 0;
+
+        this->nodes.push_back(node);
+        this->children[key] = this->nodes.size() - 1;
+
+        return this->nodes.size() - 1;
+    }
+
+    void CallProfiler::PushFrame(uint16_t addr, uint16_t sp)
+    {
+        // The matching ret will then count as unmatched, which leaves the rest of the stack intact.
+        if (this->frames.size() > this->maxDepth) {
+            this->droppedCalls++;
+            return;
+        }
+
+        Frame frame;
+        frame.node = this->GetChild(this->frames.back().node, addr);
+        frame.sp = sp;
+        frame.entryCycles = this->cycles;
+
+        this->nodes[frame.node].calls++;
+
+        RoutineTotals &routine = this->routines[addr];
+        routine.calls++;
+        routine.active++;
+
+        this->frames.push_back(frame);
+    }
+
+    // Recursive routines only count their outermost activation towards inclusive time.
+    void CallProfiler::PopFrame(std::vector<Node> &nodes, std::map<int32_t, RoutineTotals> &routines, std::vector<Frame> &frames) const
+    {
+        const Frame &frame = frames.back();
+        uint64_t elapsed = this->cycles - frame.entryCycles;
+
+        Node &node = nodes[frame.node];
+        node.inclusiveCycles += elapsed;
+
+        RoutineTotals &routine = routines[node.routine];
+
+        if (--routine.active == 0)
+            routine.inclusiveCycles += elapsed;
+
+        frames.pop_back();
+    }
+
+    void CallProfiler::HandleReturn(uint16_t sp)
+    {
+        // Frames above the match were left without a ret (tail jumps, abandoned stacks) and end here too.
+        for (size_t i = this->frames.size() - 1; i > 0; i--) {
+            if (this->frames[i].sp != sp)
+                continue;
+
+            while (this->frames.size() > i)
+                this->PopFrame(this->nodes, this->routines, this->frames);
+
+            return;
+        }
+
+        this->unmatchedReturns++;
+    }
+
+    void CallProfiler::Snapshot(std::vector<Node> &nodes, std::map<int32_t, RoutineTotals> &routines) const
+    {
+        nodes = this->nodes;
+        routines = this->routines;
+
+        std::vector<Frame> frames = this->frames;
+
+        while (frames.size() > 1)
+            this->PopFrame(nodes, routines, frames);
+
+        nodes[0].inclusiveCycles = this->cycles;
+
+        RoutineTotals &root = routines[-1];
+        root.calls = 0;
+        root.inclusiveCycles = this->cycles;
+    }
+
+    std::vector<RoutineProfile> CallProfiler::GetRoutines() const
+    {
+        std::vector<Node> nodes;
+        std::map<int32_t, RoutineTotals> routines;
+        this->Snapshot(nodes, routines);
+
+        std::map<int32_t, uint64_t> exclusive;
+
+        for (auto &node : nodes)
+            exclusive[node.routine] += node.exclusiveCycles;
+
+        std::vector<RoutineProfile> profiles;
+
+        for (auto &pair : routines) {
+            RoutineProfile profile;
+            profile.address = pair.first;
+            profile.calls = pair.second.calls;
+            profile.inclusiveCycles = pair.second.inclusiveCycles;
+            profile.exclusiveCycles = exclusive[pair.first];
+
+            profiles.push_back(profile);
+        }
+
+        return profiles;
+    }
+
+    std::vector<CallEdge> CallProfiler::GetCallEdges() const
+    {
+        std::vector<Node> nodes;
+        std::map<int32_t, RoutineTotals> routines;
+        this->Snapshot(nodes, routines);
+
+        std::map<std::pair<int32_t, int32_t>, CallEdge> edges;
+
+        for (size_t i = 1; i < nodes.size(); i++) {
+            const Node &node = nodes[i];
+            int32_t caller = nodes[node.parent].routine;
+
+            CallEdge &edge = edges[std::make_pair(caller, node.routine)];
+            edge.caller = caller;
+            edge.callee = node.routine;
+            edge.calls += node.calls;
+            edge.inclusiveCycles += node.inclusiveCycles;
+        }
+
+        std::vector<CallEdge> result;
+
+        for (auto &pair : edges)
+            result.push_back(pair.second);
+
+        return result;
+    }
+
+    std::string CallProfiler::ToString(const SymbolMap * const symbols, size_t limit) const
+    {
+        auto routines = this->GetRoutines();
+
+        std::sort(routines.begin(), routines.end(), [](const RoutineProfile &a, const RoutineProfile &b) {
+            return a.inclusiveCycles != b.inclusiveCycles ? a.inclusiveCycles > b.inclusiveCycles : a.exclusiveCycles > b.exclusiveCycles;
+        });
+
+        if (limit > 0 && routines.size() > limit)
+            routines.resize(limit);
+
+        double total = this->cycles > 0 ? this->cycles : 1;
+        std::string str = FormatString("%-24s %10s %14s %7s %14s %7s\n", "routine", "calls", "inclusive", "incl%", "exclusive", "excl%");
+
+        for (auto &routine : routines) {
+            str += FormatString("%-24s %10llu %14llu %6.2f%% %14llu %6.2f%%\n", RoutineName(routine.address, symbols).c_str(),
+                (unsigned long long)routine.calls, (unsigned long long)routine.inclusiveCycles, routine.inclusiveCycles * 100 / total,
+                (unsigned long long)routine.exclusiveCycles, routine.exclusiveCycles * 100 / total);
+        }
+
+        if (this->unmatchedReturns > 0 || this->droppedCalls > 0)
+            str += FormatString("%llu unmatched returns, %llu calls beyond max depth\n", (unsigned long long)this->unmatchedReturns, (unsigned long long)this->droppedCalls);
+
+        return str;
+    }
+
+    // Graphviz dot; nodes carry inclusive/exclusive cycles, edges carry call counts and cycles spent in the callee.
+    std::string CallProfiler::ToCallGraph(const SymbolMap * const symbols) const
+    {
+        std::string str = "digraph calls {\n    node [shape=box];\n";
+
+        for (auto &routine : this->GetRoutines()) {
+            str += FormatString("    \"%s\" [label=\"%s\\ninclusive %llu\\nexclusive %llu\"];\n", RoutineName(routine.address, symbols).c_str(),
+                RoutineName(routine.address, symbols).c_str(), (unsigned long long)routine.inclusiveCycles, (unsigned long long)routine.exclusiveCycles);
+        }
+
+        for (auto &edge : this->GetCallEdges()) {
+            str += FormatString("    \"%s\" -> \"%s\" [label=\"%llu calls\\n%llu cycles\"];\n", RoutineName(edge.caller, symbols).c_str(),
+                RoutineName(edge.callee, symbols).c_str(), (unsigned long long)edge.calls, (unsigned long long)edge.inclusiveCycles);
+        }
+
+        return str + "}\n";
+    }
+
+    std::string CallProfiler::ToFoldedStacks(const SymbolMap * const symbols) const
+    {
+        std::map<std::string, uint64_t> stacks;
+
+        for (size_t i = 0; i < this->nodes.size(); i++) {
+            if (this->nodes[i].exclusiveCycles == 0)
+                continue;
+
+            std::string stack;
+
+            for (int32_t n = i; n > 0; n = this->nodes[n].parent)
+                stack = RoutineName(this->nodes[n].routine, symbols) + (stack.empty() ? "" : ";") + stack;
+
+            stacks[stack.empty() ? "[root]" : stack] += this->nodes[i].exclusiveCycles;
+        }
+
+        std::string str;
+
+        for (auto &pair : stacks)
+            str += FormatString("%s %llu\n", pair.first.c_str(), (unsigned long long)pair.second);
+
+        return str;
+    }
+
+    void CallProfiler::Reset()
+    {
+        Node root;
+        root.routine = -1;
+        root.parent = -1;
+        root.calls = 0;
+        root.exclusiveCycles = 0;
+        root.inclusiveCycles = 0;
+
+        Frame frame;
+        frame.node = 0;
+        frame.sp = 0;
+        frame.entryCycles = 0;
+
+        this->nodes.assign(1, root);
+        this->children.clear();
+        this->frames.assign(1, frame);
+        this->routines.clear();
+
+        this->cycles = 0;
+        this->unmatchedReturns = 0;
+        this->droppedCalls = 0;
+
+        this->executing = false;
+        this->pendingCall = false;
+        this->pendingReturn = false;
+    }
+
+    size_t CallProfiler::GetDepth() const { return this->frames.size() - 1; }
+    uint64_t CallProfiler::GetTotalCycles() const { return this->cycles; }
+    uint64_t CallProfiler::GetUnmatchedReturns() const { return this->unmatchedReturns; }
+    uint64_t CallProfiler::GetDroppedCalls() const { return this->droppedCalls; }
+}
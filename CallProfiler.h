@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "CPUDelegate.h"
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    struct RoutineProfile {
+        int32_t address; // -1 for code running outside any call
+        uint64_t calls;
+        uint64_t inclusiveCycles;
+        uint64_t exclusiveCycles;
+    };
+
+    struct CallEdge {
+        int32_t caller;
+        int32_t callee;
+        uint64_t calls;
+        uint64_t inclusiveCycles;
+    };
+
+    // Shadow call stack fed by CPUDelegate::DidCall/DidReturn. Frames are matched on the stack pointer rather than the
+    // return address, so routines that rewrite their return address (xthl, pop/push of inline arguments) still unwind
+    // correctly, and a ret that matches no frame (push + ret as a computed jump, or a stack switched with sphl) is
+    // treated as a jump.
+    class CallProfiler : public CPUDelegate {
+        private:
+            // A node per distinct call path.
+            struct Node {
+                int32_t routine;
+                int32_t parent;
+                uint64_t calls;
+                uint64_t exclusiveCycles;
+                uint64_t inclusiveCycles;
+            };
+
+            struct Frame {
+                int32_t node;
+                uint16_t sp;
+                uint64_t entryCycles;
+            };
+
+            struct RoutineTotals {
+                uint64_t calls;
+                uint64_t inclusiveCycles;
+                uint32_t active;
+            };
+
+            std::vector<Node> nodes;
+            std::map<std::pair<int32_t, int32_t>, int32_t> children;
+            std::vector<Frame> frames;
+            std::map<int32_t, RoutineTotals> routines;
+
+            size_t maxDepth;
+            uint64_t cycles;
+            uint64_t unmatchedReturns;
+            uint64_t droppedCalls;
+
+            bool executing;
+            bool pendingCall;
+            bool pendingReturn;
+            uint16_t callAddress;
+            uint16_t callSP;
+            uint16_t returnSP;
+
+            int32_t GetChild(int32_t parent, int32_t routine);
+            void PushFrame(uint16_t addr, uint16_t sp);
+            void PopFrame(std::vector<Node> &nodes, std::map<int32_t, RoutineTotals> &routines, std::vector<Frame> &frames) const;
+            void HandleReturn(uint16_t sp);
+            void Snapshot(std::vector<Node> &nodes, std::map<int32_t, RoutineTotals> &routines) const;
+
+        public:
+            CallProfiler(size_t maxDepth = 1024);
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+            void DidCall(CPU * const cpu, uint16_t addr, uint16_t returnAddress) override;
+            void DidReturn(CPU * const cpu, uint16_t addr) override;
+
+            // Results; frames still on the stack count up to the current cycle.
+            std::vector<RoutineProfile> GetRoutines() const;
+            std::vector<CallEdge> GetCallEdges() const;
+            std::string ToString(const SymbolMap * const symbols = nullptr, size_t limit = 0) const;
+            std::string ToCallGraph(const SymbolMap * const symbols = nullptr) const;
+            std::string ToFoldedStacks(const SymbolMap * const symbols = nullptr) const;
+            void Reset();
+
+            // Info
+            size_t GetDepth() const;
+            uint64_t GetTotalCycles() const;
+            uint64_t GetUnmatchedReturns() const;
+            uint64_t GetDroppedCalls() const;
+    };
+}
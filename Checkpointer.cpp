@@ -0,0 +1,161 @@
+#include "Checkpointer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Emu8080
+{
+    static uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Checkpointer::Checkpointer(const std::string &filename, uint64_t interval)
+    {
+        this->filename = filename;
+        this->interval = interval > 0 ? interval : 1;
+        this->countdown = this->interval;
+
+        this->pending = false;
+        this->stop = false;
+
+        this->stats = CheckpointStats();
+
+        this->worker = std::thread(&Checkpointer::WorkerLoop, this);
+    }
+
+    Checkpointer::~Checkpointer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stop = true;
+        }
+
+        this->condition.notify_all();
+        this->worker.join();
+    }
+
+    void Checkpointer::Tick(const CPUState * const state)
+    {
+        if (this->countdown > 0)
+            this->countdown--;
+
+        // Only freeze between instructions, so the snapshot never holds a half-executed one.
+        if (this->countdown == 0 && state->GetWaitCycles() == 0) {
+            this->Capture(state);
+            this->countdown = this->interval;
+        }
+    }
+
+    bool Checkpointer::Capture(const CPUState * const state)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        // The previous checkpoint is still being written; skip this one rather than stall the guest.
+        if (this->pending) {
+            this->stats.skipped++;
+            return false;
+        }
+
+        state->CopyTo(&this->snapshot);
+        this->snapshot.SetWaitCycles(state->GetWaitCycles());
+        this->pending = true;
+
+        uint64_t pause = NanosecondsSince(start);
+        this->stats.lastPauseNanoseconds = pause;
+        this->stats.totalPauseNanoseconds += pause;
+
+        lock.unlock();
+        this->condition.notify_all();
+
+        return true;
+    }
+
+    void Checkpointer::Flush()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->condition.wait(lock, [this] { return !this->pending; });
+    }
+
+    CheckpointStats Checkpointer::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->stats;
+    }
+
+    const std::string &Checkpointer::GetFilename() const { return this->filename; }
+    uint64_t Checkpointer::GetInterval() const { return this->interval; }
+
+    void Checkpointer::WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        while (true) {
+            this->condition.wait(lock, [this] { return this->pending || this->stop; });
+
+            if (!this->pending)
+                return;
+
+            // The snapshot is not touched by Capture while pending is set, so it can be written unlocked.
+            lock.unlock();
+            this->WriteSnapshot();
+            lock.lock();
+
+            this->pending = false;
+            this->condition.notify_all();
+        }
+    }
+
+    void Checkpointer::WriteSnapshot()
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string temp = this->filename + ".tmp";
+        bool ok = true;
+
+        try {
+            this->snapshot.SaveToFile(temp.c_str());
+        } catch (const std::exception &) {
+            ok = false;
+        }
+
+        if (ok) {
+            int fd = open(temp.c_str(), O_RDONLY);
+            ok = fd >= 0 && fsync(fd) == 0;
+
+            if (fd >= 0)
+                close(fd);
+        }
+
+        // Write-then-rename, so a crash mid-write leaves the previous checkpoint intact.
+        if (ok)
+            ok = rename(temp.c_str(), this->filename.c_str()) == 0;
+
+        // The rename lives in the directory, which needs its own fsync to survive a crash.
+        if (ok) {
+            size_t slash = this->filename.find_last_of('/');
+            std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : this->filename.substr(0, slash);
+
+            int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            ok = fd >= 0 && fsync(fd) == 0;
+
+            if (fd >= 0)
+                close(fd);
+        }
+
+        uint64_t elapsed = NanosecondsSince(start);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (ok) {
+            this->stats.checkpoints++;
+            this->stats.lastWriteNanoseconds = elapsed;
+            this->stats.totalWriteNanoseconds += elapsed;
+        } else {
+            this->stats.failures++;
+        }
+    }
+}
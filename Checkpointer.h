@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "CPUState.h"
+
+namespace Emu8080
+{
+    struct CheckpointStats {
+        uint64_t checkpoints;
+        uint64_t skipped;
+        uint64_t failures;
+
+        uint64_t lastPauseNanoseconds;
+        uint64_t totalPauseNanoseconds;
+        uint64_t lastWriteNanoseconds;
+        uint64_t totalWriteNanoseconds;
+    };
+
+    class Checkpointer {
+        private:
+            std::string filename;
+            uint64_t interval;
+            uint64_t countdown;
+
+            CPUState snapshot;
+            bool pending;
+            bool stop;
+
+            CheckpointStats stats;
+
+            mutable std::mutex mutex;
+            std::condition_variable condition;
+            std::thread worker;
+
+            void WorkerLoop();
+            void WriteSnapshot();
+
+        public:
+            Checkpointer(const std::string &filename, uint64_t interval);
+            ~Checkpointer();
+
+            // Capture
+            void Tick(const CPUState * const state);
+            bool Capture(const CPUState * const state);
+            void Flush();
+
+            // Stats
+            CheckpointStats GetStats() const;
+            const std::string &GetFilename() const;
+            uint64_t GetInterval() const;
+    };
+}
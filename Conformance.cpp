@@ -0,0 +1,138 @@
+#include "Conformance.h"
+
+namespace Emu8080
+{
+    static const uint8_t FlagS = 1 << 7;
+    static const uint8_t FlagZ = 1 << 6;
+    static const uint8_t FlagA = 1 << 4;
+    static const uint8_t FlagP = 1 << 2;
+    static const uint8_t FlagC = 1 << 0;
+
+    const std::vector<uint8_t> &ConformanceOpcodes()
+    {
+        static std::vector<uint8_t> opcodes;
+
+        if (opcodes.empty()) {
+            for (uint8_t op = 0; op < 8; op++) {
+                opcodes.push_back(0x80 | (op << 3));
+                opcodes.push_back(0xC6 | (op << 3));
+            }
+
+            const uint8_t single[] = { 0x3C, 0x3D, 0x07, 0x0F, 0x17, 0x1F, 0x27, 0x2F, 0x37, 0x3F };
+            opcodes.insert(opcodes.end(), single, single + sizeof(single));
+        }
+
+        return opcodes;
+    }
+
+    bool ConformanceTakesOperand(uint8_t opcode)
+    {
+        return (opcode & 0xC7) == 0x80 || (opcode & 0xC7) == 0xC6;
+    }
+
+    static uint8_t SZP(uint8_t n)
+    {
+        uint8_t flags = n & FlagS;
+
+        if (n == 0)
+            flags |= FlagZ;
+
+        if ((__builtin_popcount(n) & 1) == 0)
+            flags |= FlagP;
+
+        return flags;
+    }
+
+    // Sum of a, b and carry, with the carry out of bit 7 and the auxiliary carry out of bit 3.
+    static uint8_t AddWithCarry(uint8_t a, uint8_t b, bool carry, uint8_t *flags)
+    {
+        uint16_t sum = a + b + carry;
+        uint8_t result = sum;
+
+        *flags = SZP(result) | 0b10;
+
+        if (sum > 0xFF)
+            *flags |= FlagC;
+        if ((a ^ b ^ result) & 0x10)
+            *flags |= FlagA;
+
+        return result;
+    }
+
+    void ReferenceALU(uint8_t opcode, uint8_t a, uint8_t operand, uint8_t flags, uint8_t *resultA, uint8_t *resultFlags)
+    {
+        bool carry = flags & FlagC;
+        uint8_t out = flags;
+        uint8_t result = a;
+
+        if (ConformanceTakesOperand(opcode)) {
+            switch ((opcode >> 3) & 0b111) {
+                case 0b000: result = AddWithCarry(a, operand, false, &out); break;
+                case 0b001: result = AddWithCarry(a, operand, carry, &out); break;
+                case 0b010:
+                case 0b011:
+                case 0b111: {
+                    // Subtraction is a + ~operand + !borrow; the 8080 stores the inverted carry.
+                    bool borrow = ((opcode >> 3) & 0b111) == 0b011 && carry;
+                    uint8_t difference = AddWithCarry(a, ~operand, !borrow, &out);
+
+                    out ^= FlagC;
+
+                    if (((opcode >> 3) & 0b111) != 0b111)
+                        result = difference;
+
+                    break;
+                }
+                case 0b100: {
+                    result = a & operand;
+                    out = SZP(result) | 0b10 | (((a | operand) & 0x08) ? FlagA : 0);
+                    break;
+                }
+                case 0b101: result = a ^ operand; out = SZP(result) | 0b10; break;
+                case 0b110: result = a | operand; out = SZP(result) | 0b10; break;
+            }
+        } else {
+            switch (opcode) {
+                case 0x3C: {
+                    // inr a
+                    result = a + 1;
+                    out = SZP(result) | 0b10 | (flags & FlagC) | ((result & 0xF) == 0 ? FlagA : 0);
+                    break;
+                }
+                case 0x3D: {
+                    // dcr a
+                    result = a - 1;
+                    out = SZP(result) | 0b10 | (flags & FlagC) | ((result & 0xF) != 0xF ? FlagA : 0);
+                    break;
+                }
+                case 0x07: result = (a << 1) | (a >> 7); out = (flags & ~FlagC) | (a >> 7); break;
+                case 0x0F: result = (a >> 1) | (a << 7); out = (flags & ~FlagC) | (a & 1); break;
+                case 0x17: result = (a << 1) | carry; out = (flags & ~FlagC) | (a >> 7); break;
+                case 0x1F: result = (a >> 1) | (carry << 7); out = (flags & ~FlagC) | (a & 1); break;
+                case 0x27: {
+                    // daa
+                    uint8_t correction = 0;
+                    bool carryOut = carry;
+
+                    if ((flags & FlagA) || (a & 0xF) > 9)
+                        correction |= 0x06;
+
+                    if (carry || (a >> 4) > 9 || ((a >> 4) >= 9 && (a & 0xF) > 9)) {
+                        correction |= 0x60;
+                        carryOut = true;
+                    }
+
+                    result = AddWithCarry(a, correction, false, &out);
+                    out = (out & ~FlagC) | (carryOut ? FlagC : 0);
+                    break;
+                }
+                case 0x2F: result = ~a; break;
+                case 0x37: out = flags | FlagC; break;
+                case 0x3F: out = flags ^ FlagC; break;
+            }
+        }
+
+        *resultA = result;
+        *resultFlags = out;
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#include "CPUState.h"
+
+namespace Emu8080
+{
+    struct ConformanceFailure {
+        uint8_t opcode;
+        uint8_t a;
+        uint8_t operand;
+        uint8_t flags;
+
+        uint8_t expectedA;
+        uint8_t expectedFlags;
+        uint8_t actualA;
+        uint8_t actualFlags;
+    };
+
+    struct ConformanceReport {
+        uint64_t cases;
+        uint64_t failures;
+        std::vector<ConformanceFailure> samples;
+        double seconds;
+    };
+
+    // Opcodes covered by the sweep: every ALU operation in register (b) and immediate form, and
+    // the single-operand instructions on a. Opcodes that take an operand are swept over all 256.
+    const std::vector<uint8_t> &ConformanceOpcodes();
+    bool ConformanceTakesOperand(uint8_t opcode);
+
+    // Reference model of the 8080 ALU: the a register and flags after executing opcode.
+    void ReferenceALU(uint8_t opcode, uint8_t a, uint8_t operand, uint8_t flags, uint8_t *resultA, uint8_t *resultFlags);
+
+    // Checks every opcode x a x operand x incoming flag state against ReferenceALU, spread over
+    // threads. Engines come from create (one per thread, deleted afterwards) and, like CPU, need
+    // GetState() and ExecuteInstruction().
+    template<typename Engine>
+    ConformanceReport RunALUConformance(const std::function<Engine *()> &create, unsigned threads = 0, size_t maxSamples = 16)
+    {
+        const std::vector<uint8_t> &opcodes = ConformanceOpcodes();
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::atomic<uint32_t> next(0);
+        std::atomic<uint64_t> cases(0);
+        std::atomic<uint64_t> failures(0);
+        std::mutex mutex;
+
+        ConformanceReport report;
+        auto start = std::chrono::steady_clock::now();
+
+        // Work items are (opcode, a) pairs.
+        auto worker = [&]() {
+            Engine *engine = create();
+            CPUState *state = engine->GetState();
+            uint64_t count = 0;
+
+            while (true) {
+                uint32_t item = next++;
+
+                if (item >= opcodes.size() * 256)
+                    break;
+
+                uint8_t opcode = opcodes[item / 256];
+                uint8_t a = item % 256;
+                uint32_t operands = ConformanceTakesOperand(opcode) ? 256 : 1;
+
+                state->WriteByte(0, opcode);
+
+                for (uint32_t operand = 0; operand < operands; operand++) {
+                    state->WriteByte(1, operand);
+
+                    // Flags: every combination of s, z, a, p and c, with bit 1 set.
+                    for (uint32_t bits = 0; bits < 32; bits++) {
+                        uint8_t flags = ((bits & 0b11000) << 3) | ((bits & 0b100) << 2) | ((bits & 0b10) << 1) | (bits & 0b1) | 0b10;
+
+                        // CPUState registers are indexed a, b, c, d, e, h, l.
+                        state->SetRegister(0, a);
+                        state->SetRegister(1, operand);
+                        state->SetFlags(flags);
+                        state->SetPC(0);
+
+                        engine->ExecuteInstruction();
+
+                        uint8_t expectedA, expectedFlags;
+                        ReferenceALU(opcode, a, operand, flags, &expectedA, &expectedFlags);
+
+                        uint8_t actualA = state->GetRegister(0);
+                        uint8_t actualFlags = state->GetFlags();
+
+                        if (actualA != expectedA || actualFlags != expectedFlags) {
+                            failures++;
+
+                            std::lock_guard<std::mutex> lock(mutex);
+
+                            if (report.samples.size() < maxSamples) {
+                                ConformanceFailure failure = { opcode, a, (uint8_t)operand, flags, expectedA, expectedFlags, actualA, actualFlags };
+                                report.samples.push_back(failure);
+                            }
+                        }
+
+                        count++;
+                    }
+                }
+            }
+
+            cases += count;
+            delete engine;
+        };
+
+        std::vector<std::thread> pool;
+
+        for (unsigned i = 0; i < threads; i++)
+            pool.push_back(std::thread(worker));
+
+        for (auto &thread : pool)
+            thread.join();
+
+        report.cases = cases;
+        report.failures = failures;
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return report;
+    }
+}
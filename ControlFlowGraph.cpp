@@ -0,0 +1,465 @@
+#include "ControlFlowGraph.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "Disassembler.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    enum class Flow { Next, Jump, Branch, Call, Rst, Return, ConditionalReturn, Halt, Indirect };
+
+    // Undocumented opcodes behave as their documented twins: 0xcb is jmp, 0xd9 ret, 0xdd/0xed/0xfd call.
+    static Flow ClassifyOpcode(uint8_t opcode)
+    {
+        if (opcode == 0xC3 || opcode == 0xCB)
+            return Flow::Jump;
+        if ((opcode & 0xCF) == 0xCD || (opcode & 0xC7) == 0xC4)
+            return Flow::Call;
+        if ((opcode & 0xC7) == 0xC2)
+            return Flow::Branch;
+        if (opcode == 0xC9 || opcode == 0xD9)
+            return Flow::Return;
+        if ((opcode & 0xC7) == 0xC0)
+            return Flow::ConditionalReturn;
+        if ((opcode & 0xC7) == 0xC7)
+            return Flow::Rst;
+        if (opcode == 0x76)
+            return Flow::Halt;
+        if (opcode == 0xE9)
+            return Flow::Indirect;
+
+        return Flow::Next;
+    }
+
+    ControlFlowGraph::ControlFlowGraph()
+    {
+        this->conflicts = 0;
+    }
+
+    void ControlFlowGraph::Analyze(const uint8_t * const memory, uint32_t size, const std::vector<uint16_t> &entries)
+    {
+        this->image.assign(memory, memory + std::min<uint32_t>(size, 0x10000));
+        this->flags.assign(this->image.size(), 0);
+
+        this->blocks.clear();
+        this->edges.clear();
+        this->tables.clear();
+        this->unresolved.clear();
+        this->conflicts = 0;
+
+        for (auto entry : entries)
+            this->AddTarget(entry, Entry);
+
+        while (!this->worklist.empty()) {
+            uint16_t addr = this->worklist.back();
+            this->worklist.pop_back();
+            this->Trace(addr);
+        }
+
+        this->BuildBlocks();
+    }
+
+    void ControlFlowGraph::AddTarget(uint32_t addr, uint8_t kind)
+    {
+        if (addr >= this->image.size())
+            return;
+
+        this->flags[addr] |= Leader | kind;
+
+        if (!(this->flags[addr] & Code))
+            this->worklist.push_back(addr);
+    }
+
+    // Decodes forward from start until control leaves for good, queueing every target it finds.
+    void ControlFlowGraph::Trace(uint16_t start)
+    {
+        uint32_t size = this->image.size();
+        uint32_t addr = start;
+
+        // The instructions decoded in this run, for looking back from a pchl.
+        uint16_t recent[8];
+        size_t count = 0;
+
+        while (addr < size) {
+            if (this->flags[addr] & Code) {
+                // Reached from two directions, so a block must start here.
+                this->flags[addr] |= Leader;
+                return;
+            }
+
+            uint8_t opcode = this->image[addr];
+            uint8_t length = OpcodeTable[opcode].length;
+
+            if (addr + length > size)
+                return;
+
+            for (uint8_t i = 0; i < length; i++) {
+                if (this->flags[addr + i] & (Body | Data)) {
+                    this->conflicts++;
+                    return;
+                }
+            }
+
+            this->flags[addr] |= Code;
+
+            for (uint8_t i = 0; i < length; i++)
+                this->flags[addr + i] |= Body;
+
+            recent[count++ % 8] = addr;
+
+            uint16_t target = length == 3 ? this->image[addr + 1] | this->image[addr + 2] << 8 : 0;
+            uint32_t next = addr + length;
+
+            switch (ClassifyOpcode(opcode)) {
+                case Flow::Next:
+                    break;
+
+                case Flow::Jump:
+                    this->AddTarget(target, JumpTarget);
+                    return;
+
+                case Flow::Branch:
+                    this->AddTarget(target, JumpTarget);
+                    this->AddTarget(next, 0);
+                    return;
+
+                case Flow::Call:
+                    this->AddTarget(target, CallTarget);
+                    this->AddTarget(next, 0);
+                    return;
+
+                case Flow::Rst:
+                    this->AddTarget(opcode & 0x38, CallTarget);
+                    this->AddTarget(next, 0);
+                    return;
+
+                case Flow::Return:
+                    return;
+
+                // hlt resumes at the next instruction once an interrupt has been serviced.
+                case Flow::ConditionalReturn:
+                case Flow::Halt:
+                    this->AddTarget(next, 0);
+                    return;
+
+                case Flow::Indirect: {
+                    // recent holds the last min(count, 8) instructions, oldest first once rotated.
+                    uint16_t ordered[8];
+                    size_t n = std::min<size_t>(count, 8);
+
+                    for (size_t i = 0; i < n; i++)
+                        ordered[i] = recent[(count - n + i) % 8];
+
+                    if (!this->ResolveJumpTable(addr, ordered, n))
+                        this->unresolved.push_back(addr);
+
+                    return;
+                }
+            }
+
+            addr = next;
+        }
+    }
+
+    // Looks back for the last lxi of b, d or h and takes its operand as the table; a table of jmp
+    // instructions is followed as code, a table of words for as long as the words look like code addresses.
+    bool ControlFlowGraph::ResolveJumpTable(uint16_t site, const uint16_t * const recent, size_t count)
+    {
+        uint32_t size = this->image.size();
+        int32_t base = -1;
+
+        for (size_t i = count; i-- > 0;) {
+            uint8_t opcode = this->image[recent[i]];
+
+            if ((opcode & 0xCF) == 0x01 && opcode != 0x31) {
+                base = this->image[recent[i] + 1] | this->image[recent[i] + 2] << 8;
+                break;
+            }
+        }
+
+        if (base < 0)
+            return false;
+
+        JumpTable table = { site, (uint16_t)base, 0, 2 };
+
+        if (base < (int32_t)size && (this->image[base] == 0xC3 || this->image[base] == 0xCB)) {
+            table.stride = 3;
+
+            for (uint32_t entry = base; table.entries < MaxTableEntries && entry + 2 < size; entry += 3, table.entries++) {
+                if (this->image[entry] != 0xC3 && this->image[entry] != 0xCB)
+                    break;
+                if ((this->flags[entry] & (Body | Data)) && !(this->flags[entry] & Code))
+                    break;
+
+                this->AddTarget(entry, JumpTarget);
+            }
+        } else {
+            for (uint32_t entry = base; table.entries < MaxTableEntries && entry + 1 < size; entry += 2) {
+                uint16_t target = this->image[entry] | this->image[entry + 1] << 8;
+
+                // Stop at the first word that can't be an entry: null, outside the image, inside the table
+                // itself, or in the middle of code already decoded.
+                if ((this->flags[entry] | this->flags[entry + 1]) & Body)
+                    break;
+                if (target == 0 || target >= size || (target >= (uint32_t)base && target < entry + 2))
+                    break;
+                if ((this->flags[target] & (Body | Data)) && !(this->flags[target] & Code))
+                    break;
+
+                this->flags[entry] |= Data;
+                this->flags[entry + 1] |= Data;
+                this->AddTarget(target, JumpTarget);
+
+                table.entries++;
+            }
+        }
+
+        if (table.entries == 0)
+            return false;
+
+        this->tables.push_back(table);
+        return true;
+    }
+
+    void ControlFlowGraph::BuildBlocks()
+    {
+        uint32_t size = this->image.size();
+        BasicBlock *current = nullptr;
+
+        for (uint32_t addr = 0; addr < size;) {
+            if (!(this->flags[addr] & Code)) {
+                current = nullptr;
+                addr++;
+                continue;
+            }
+
+            if (current == nullptr || (this->flags[addr] & Leader)) {
+                BasicBlock block = { (uint16_t)addr, (uint16_t)addr, addr, 0, 0, 0 };
+                this->blocks.push_back(block);
+                current = &this->blocks.back();
+            }
+
+            uint8_t opcode = this->image[addr];
+            current->last = addr;
+            current->end = addr + OpcodeTable[opcode].length;
+            current->instructions++;
+
+            if (ClassifyOpcode(opcode) != Flow::Next)
+                current = nullptr;
+
+            addr += OpcodeTable[opcode].length;
+        }
+
+        for (auto &block : this->blocks) {
+            uint8_t opcode = this->image[block.last];
+            uint16_t target = OpcodeTable[opcode].length == 3 ? this->image[block.last + 1] | this->image[block.last + 2] << 8 : 0;
+            bool fallsThrough = true;
+
+            block.firstEdge = this->edges.size();
+
+            switch (ClassifyOpcode(opcode)) {
+                case Flow::Jump:
+                    this->edges.push_back({ block.start, target, EdgeKind::Jump });
+                    fallsThrough = false;
+                    break;
+
+                case Flow::Branch:
+                    this->edges.push_back({ block.start, target, EdgeKind::Branch });
+                    break;
+
+                case Flow::Call:
+                    this->edges.push_back({ block.start, target, EdgeKind::Call });
+                    break;
+
+                case Flow::Rst:
+                    this->edges.push_back({ block.start, (uint16_t)(opcode & 0x38), EdgeKind::Call });
+                    break;
+
+                case Flow::Return:
+                    fallsThrough = false;
+                    break;
+
+                case Flow::Indirect:
+                    for (auto &table : this->tables) {
+                        if (table.site != block.last)
+                            continue;
+
+                        for (uint32_t i = 0; i < table.entries; i++) {
+                            uint32_t entry = table.address + i * table.stride;
+                            uint16_t to = table.stride == 3 ? entry : this->image[entry] | this->image[entry + 1] << 8;
+                            this->edges.push_back({ block.start, to, EdgeKind::Table });
+                        }
+                    }
+
+                    fallsThrough = false;
+                    break;
+
+                default:
+                    break;
+            }
+
+            if (fallsThrough && block.end < size && (this->flags[block.end] & Code))
+                this->edges.push_back({ block.start, (uint16_t)block.end, EdgeKind::FallThrough });
+
+            block.edgeCount = this->edges.size() - block.firstEdge;
+        }
+    }
+
+    const std::vector<BasicBlock> &ControlFlowGraph::GetBlocks() const { return this->blocks; }
+    const std::vector<CFGEdge> &ControlFlowGraph::GetEdges() const { return this->edges; }
+    const std::vector<JumpTable> &ControlFlowGraph::GetJumpTables() const { return this->tables; }
+    const std::vector<uint16_t> &ControlFlowGraph::GetUnresolvedJumps() const { return this->unresolved; }
+    uint32_t ControlFlowGraph::GetConflicts() const { return this->conflicts; }
+
+    const BasicBlock * const ControlFlowGraph::FindBlock(uint16_t addr) const
+    {
+        auto it = std::upper_bound(this->blocks.begin(), this->blocks.end(), addr, [](uint16_t addr, const BasicBlock &block) {
+            return addr < block.start;
+        });
+
+        if (it == this->blocks.begin() || addr >= (it - 1)->end)
+            return nullptr;
+
+        return &*(it - 1);
+    }
+
+    bool ControlFlowGraph::IsInstruction(uint16_t addr) const
+    {
+        return addr < this->flags.size() && (this->flags[addr] & Code);
+    }
+
+    uint32_t ControlFlowGraph::GetCodeBytes() const
+    {
+        uint32_t count = 0;
+
+        for (auto flag : this->flags)
+            count += (flag & Body) != 0;
+
+        return count;
+    }
+
+    std::string ControlFlowGraph::Label(uint16_t addr, const SymbolMap * const symbols) const
+    {
+        const Symbol *symbol = symbols != nullptr ? symbols->Lookup(addr) : nullptr;
+
+        if (symbol != nullptr && symbol->address == addr)
+            return symbol->name;
+
+        uint8_t flag = addr < this->flags.size() ? this->flags[addr] : 0;
+
+        if (flag & Entry)
+            return FormatString("entry_%04x", addr);
+        if (flag & CallTarget)
+            return FormatString("sub_%04x", addr);
+        if (flag & JumpTarget)
+            return FormatString("L_%04x", addr);
+
+        return "";
+    }
+
+    // Entry points and call targets become routines; branch targets stay local labels.
+    void ControlFlowGraph::ExportSymbols(SymbolMap * const symbols) const
+    {
+        for (uint32_t addr = 0; addr < this->flags.size(); addr++) {
+            if (!(this->flags[addr] & (Entry | CallTarget)) || !(this->flags[addr] & Code))
+                continue;
+
+            const Symbol *symbol = symbols->Lookup(addr);
+
+            if (symbol == nullptr || symbol->address != addr)
+                symbols->Add(addr, this->Label(addr, nullptr));
+        }
+    }
+
+    std::string ControlFlowGraph::ToDot(const SymbolMap * const symbols) const
+    {
+        static const char *styles[] = { "", " [style=bold]", " [color=green]", " [style=dashed]", " [style=dotted]" };
+
+        std::string str = "digraph cfg {\n    node [shape=box, fontname=\"monospace\"];\n";
+        char text[MaxInstructionText];
+
+        for (auto &block : this->blocks) {
+            std::string label = this->Label(block.start, symbols);
+            std::string body = label.empty() ? "" : label + ":\\l";
+
+            for (uint32_t addr = block.start; addr < block.end; addr += OpcodeTable[this->image[addr]].length) {
+                DisassembleInstruction(&this->image[addr], text);
+                body += FormatString("%04x  %s\\l", addr, text);
+            }
+
+            str += FormatString("    \"%04x\" [label=\"%s\"];\n", block.start, body.c_str());
+        }
+
+        for (auto &edge : this->edges)
+            str += FormatString("    \"%04x\" -> \"%04x\"%s;\n", edge.from, edge.to, styles[(int)edge.kind]);
+
+        return str + "}\n";
+    }
+
+    std::string ControlFlowGraph::ToListing(const SymbolMap * const symbols) const
+    {
+        uint32_t size = this->image.size();
+        std::string str;
+        char text[MaxInstructionText];
+
+        for (auto &table : this->tables)
+            str += FormatString("; pchl at %04x: %u-entry %s table at %04x\n", table.site, table.entries, table.stride == 3 ? "jmp" : "address", table.address);
+        for (auto site : this->unresolved)
+            str += FormatString("; pchl at %04x: unresolved\n", site);
+
+        for (uint32_t addr = 0; addr < size;) {
+            std::string label = this->Label(addr, symbols);
+
+            if (!label.empty())
+                str += label + ":\n";
+
+            uint8_t flag = this->flags[addr];
+
+            if (flag & Code) {
+                const uint8_t *bytes = &this->image[addr];
+                const OpcodeInfo &info = OpcodeTable[bytes[0]];
+                Flow flow = ClassifyOpcode(bytes[0]);
+                std::string target;
+
+                if (info.operand == OperandKind::Data16 && (flow == Flow::Jump || flow == Flow::Branch || flow == Flow::Call))
+                    target = this->Label(bytes[1] | bytes[2] << 8, symbols);
+
+                if (!target.empty()) {
+                    memcpy(text, info.text, info.textLength);
+                    text[info.textLength] = 0;
+                } else {
+                    DisassembleInstruction(bytes, text);
+                }
+
+                std::string hex;
+
+                for (uint8_t i = 0; i < info.length; i++)
+                    hex += FormatString("%02x ", bytes[i]);
+
+                str += FormatString("    %04x  %-9s  %s%s%s\n", addr, hex.c_str(), text, target.empty() ? "" : " ", target.c_str());
+                addr += info.length;
+            } else if ((flag & Data) && addr + 1 < size && (this->flags[addr + 1] & Data)) {
+                uint16_t word = this->image[addr] | this->image[addr + 1] << 8;
+                std::string target = this->Label(word, symbols);
+
+                str += FormatString("    %04x  %02x %02x      dw %s\n", addr, this->image[addr], this->image[addr + 1], target.empty() ? FormatString("$%x", word).c_str() : target.c_str());
+                addr += 2;
+            } else {
+                // Up to eight unreached bytes per line, stopping at anything that needs its own line.
+                std::string values;
+                uint32_t start = addr;
+
+                do {
+                    values += FormatString("%s$%x", values.empty() ? "" : ", ", this->image[addr]);
+                    addr++;
+                } while (addr < size && addr - start < 8 && !(this->flags[addr] & (Code | Data)) && this->Label(addr, symbols).empty());
+
+                str += FormatString("    %04x  %-9s  db %s\n", start, "", values.c_str());
+            }
+        }
+
+        return str;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    // A straight-line run of instructions. Blocks end at jumps, calls, returns, rst, hlt and pchl, or just
+    // before another block's start; end is one past the last instruction byte.
+    struct BasicBlock {
+        uint16_t start;
+        uint16_t last;
+        uint32_t end;
+        uint32_t instructions;
+
+        // This block's outgoing edges are edges[firstEdge, firstEdge + edgeCount).
+        uint32_t firstEdge;
+        uint32_t edgeCount;
+    };
+
+    enum class EdgeKind : uint8_t { FallThrough, Jump, Branch, Call, Table };
+
+    struct CFGEdge {
+        uint16_t from;
+        uint16_t to;
+        EdgeKind kind;
+    };
+
+    // A pchl resolved to a table of addresses (stride 2) or of jmp instructions (stride 3).
+    struct JumpTable {
+        uint16_t site;
+        uint16_t address;
+        uint16_t entries;
+        uint8_t stride;
+    };
+
+    // Recursive-traversal disassembly: only bytes reachable from the entry points are decoded, following
+    // both sides of every branch and assuming calls return. A pchl is resolved when the block before it
+    // loads a register pair with the address of something that looks like a jump table; otherwise it is
+    // listed as unresolved.
+    class ControlFlowGraph {
+        private:
+            enum : uint8_t {
+                Code = 1 << 0,
+                Body = 1 << 1,
+                Leader = 1 << 2,
+                Entry = 1 << 3,
+                CallTarget = 1 << 4,
+                JumpTarget = 1 << 5,
+                Data = 1 << 6
+            };
+
+            static const uint32_t MaxTableEntries = 64;
+
+            std::vector<uint8_t> image;
+            std::vector<uint8_t> flags;
+
+            std::vector<BasicBlock> blocks;
+            std::vector<CFGEdge> edges;
+            std::vector<JumpTable> tables;
+            std::vector<uint16_t> unresolved;
+            uint32_t conflicts;
+
+            std::vector<uint16_t> worklist;
+
+            void AddTarget(uint32_t addr, uint8_t kind);
+            void Trace(uint16_t start);
+            bool ResolveJumpTable(uint16_t site, const uint16_t * const recent, size_t count);
+            void BuildBlocks();
+            std::string Label(uint16_t addr, const SymbolMap * const symbols) const;
+
+        public:
+            ControlFlowGraph();
+
+            void Analyze(const uint8_t * const memory, uint32_t size, const std::vector<uint16_t> &entries);
+
+            // Results
+            const std::vector<BasicBlock> &GetBlocks() const;
+            const BasicBlock * const FindBlock(uint16_t addr) const;
+            const std::vector<CFGEdge> &GetEdges() const;
+            const std::vector<JumpTable> &GetJumpTables() const;
+            const std::vector<uint16_t> &GetUnresolvedJumps() const;
+            uint32_t GetConflicts() const;
+            bool IsInstruction(uint16_t addr) const;
+            uint32_t GetCodeBytes() const;
+
+            // Export; names come from symbols where they have an exact match, and are generated otherwise.
+            void ExportSymbols(SymbolMap * const symbols) const;
+            std::string ToDot(const SymbolMap * const symbols = nullptr) const;
+            std::string ToListing(const SymbolMap * const symbols = nullptr) const;
+    };
+}
@@ -0,0 +1,200 @@
+#include "Coverage.h"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "CPU.h"
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    static const char CoverageMagic[4] = { 'E', '8', '0', 'C' };
+    static const uint32_t CoverageVersion = 1;
+
+    const uint32_t Coverage::Words;
+
+    Coverage::Coverage()
+    {
+        for (int i = 0; i < 256; i++)
+            Encode::DecodeMnemonic(i, &this->sizes[i]);
+
+        this->Reset();
+    }
+
+    // jcc, ccc and rcc.
+    bool Coverage::IsConditional(uint8_t opcode)
+    {
+        uint8_t group = opcode & 0xC7;
+        return group == 0xC0 || group == 0xC2 || group == 0xC4;
+    }
+
+    bool Coverage::Test(const uint64_t * const bitmap, uint16_t addr)
+    {
+        return ((bitmap[addr >> 6] >> (addr & 63)) & 1) != 0;
+    }
+
+    uint32_t Coverage::GetHooks() const { return HookRetire; }
+
+    void Coverage::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        uint64_t bit = (uint64_t)1 << (pc & 63);
+        this->executed[pc >> 6] |= bit;
+
+        if (!IsConditional(opcode))
+            return;
+
+        if (cpu->GetState()->GetPC() == (uint16_t)(pc + this->sizes[opcode]))
+            this->notTaken[pc >> 6] |= bit;
+        else
+            this->taken[pc >> 6] |= bit;
+    }
+
+    bool Coverage::IsExecuted(uint16_t addr) const { return Test(this->executed, addr); }
+    bool Coverage::IsTaken(uint16_t addr) const { return Test(this->taken, addr); }
+    bool Coverage::IsNotTaken(uint16_t addr) const { return Test(this->notTaken, addr); }
+
+    void Coverage::Merge(const Coverage * const other)
+    {
+        for (uint32_t i = 0; i < Coverage::Words; i++) {
+            this->executed[i] |= other->executed[i];
+            this->taken[i] |= other->taken[i];
+            this->notTaken[i] |= other->notTaken[i];
+        }
+    }
+
+    void Coverage::Reset()
+    {
+        std::fill(this->executed, this->executed + Coverage::Words, 0);
+        std::fill(this->taken, this->taken + Coverage::Words, 0);
+        std::fill(this->notTaken, this->notTaken + Coverage::Words, 0);
+    }
+
+    void Coverage::SaveToFile(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "wb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        bool ok = fwrite(CoverageMagic, 1, sizeof(CoverageMagic), file) == sizeof(CoverageMagic);
+        ok = ok && fwrite(&CoverageVersion, sizeof(CoverageVersion), 1, file) == 1;
+        ok = ok && fwrite(this->executed, sizeof(this->executed), 1, file) == 1;
+        ok = ok && fwrite(this->taken, sizeof(this->taken), 1, file) == 1;
+        ok = ok && fwrite(this->notTaken, sizeof(this->notTaken), 1, file) == 1;
+
+        if (fclose(file) != 0)
+            ok = false;
+
+        if (!ok)
+            throw std::runtime_error(FormatString("Failed to write coverage '%s'.", filename));
+    }
+
+    void Coverage::LoadFromFile(const char * const filename)
+    {
+        FILE *file = fopen(filename, "rb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        char magic[4];
+        uint32_t version;
+
+        bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CoverageMagic, sizeof(magic)) == 0;
+        ok = ok && fread(&version, sizeof(version), 1, file) == 1 && version == CoverageVersion;
+        ok = ok && fread(this->executed, sizeof(this->executed), 1, file) == 1;
+        ok = ok && fread(this->taken, sizeof(this->taken), 1, file) == 1;
+        ok = ok && fread(this->notTaken, sizeof(this->notTaken), 1, file) == 1;
+
+        fclose(file);
+
+        if (!ok) {
+            this->Reset();
+            throw std::runtime_error(FormatString("'%s' is not a valid coverage file.", filename));
+        }
+    }
+
+    // Walks the range as a linear disassembly. Executed addresses are always instruction starts, so the walk
+    // resyncs on them after running through data.
+    CoverageSummary Coverage::GetSummary(const CPUState * const state, uint16_t start, uint16_t end) const
+    {
+        CoverageSummary summary = CoverageSummary();
+        const uint8_t *memory = state->GetMemory();
+        uint32_t limit = std::min<uint32_t>(end, state->GetMemorySize() - 1);
+
+        for (uint32_t addr = start; addr <= limit;) {
+            uint8_t opcode = memory[addr];
+            uint8_t size = this->sizes[opcode];
+
+            for (uint32_t i = 1; i < size && addr + i <= limit; i++) {
+                if (this->IsExecuted(addr + i))
+                    size = i;
+            }
+
+            summary.instructions++;
+
+            if (this->IsExecuted(addr))
+                summary.executedInstructions++;
+
+            if (IsConditional(opcode)) {
+                summary.branches++;
+
+                if (this->IsTaken(addr))
+                    summary.branchesTaken++;
+                if (this->IsNotTaken(addr))
+                    summary.branchesNotTaken++;
+                if (this->IsTaken(addr) && this->IsNotTaken(addr))
+                    summary.branchesBoth++;
+            }
+
+            addr += size;
+        }
+
+        return summary;
+    }
+
+    // One line per instruction: '+' executed, '-' not; conditional branches show T/N for each direction seen.
+    std::string Coverage::ToString(const CPUState * const state, uint16_t start, uint16_t end, const SymbolMap * const symbols) const
+    {
+        CoverageSummary summary = this->GetSummary(state, start, end);
+        const uint8_t *memory = state->GetMemory();
+        uint32_t limit = std::min<uint32_t>(end, state->GetMemorySize() - 1);
+
+        std::string str = FormatString("instructions %u/%u (%.2f%%), branches %u: both %u, taken only %u, not taken only %u, neither %u\n",
+            summary.executedInstructions, summary.instructions, summary.instructions > 0 ? summary.executedInstructions * 100.0 / summary.instructions : 0,
+            summary.branches, summary.branchesBoth, summary.branchesTaken - summary.branchesBoth, summary.branchesNotTaken - summary.branchesBoth,
+            summary.branches - summary.branchesTaken - summary.branchesNotTaken + summary.branchesBoth);
+
+        for (uint32_t addr = start; addr <= limit;) {
+            uint8_t opcode = memory[addr];
+            uint8_t size = this->sizes[opcode];
+
+            for (uint32_t i = 1; i < size && addr + i <= limit; i++) {
+                if (this->IsExecuted(addr + i))
+                    size = i;
+            }
+
+            if (symbols != nullptr) {
+                const Symbol *symbol = symbols->Lookup(addr);
+
+                if (symbol != nullptr && symbol->address == addr)
+                    str += symbol->name + ":\n";
+            }
+
+            // Operands past the end of memory read as zero rather than out of bounds.
+            uint8_t bytes[3] = { opcode, 0, 0 };
+            for (uint32_t i = 1; i < 3 && addr + i < state->GetMemorySize(); i++)
+                bytes[i] = memory[addr + i];
+
+            std::string branch = "  ";
+            if (IsConditional(opcode))
+                branch = FormatString("%c%c", this->IsTaken(addr) ? 'T' : '-', this->IsNotTaken(addr) ? 'N' : '-');
+
+            str += FormatString("%c %s 0x%04x  %s\n", this->IsExecuted(addr) ? '+' : '-', branch.c_str(), addr, Encode::DecodeInstruction(bytes).c_str());
+            addr += size;
+        }
+
+        return str;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "CPUDelegate.h"
+#include "CPUState.h"
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    struct CoverageSummary {
+        uint32_t instructions;
+        uint32_t executedInstructions;
+        uint32_t branches;
+        uint32_t branchesTaken;
+        uint32_t branchesNotTaken;
+        uint32_t branchesBoth;
+    };
+
+    // Bitmaps over the 64K address space: instruction start addresses that executed, and for conditional
+    // jumps, calls and returns, which directions were seen. Runs merge with a bitwise OR.
+    class Coverage : public CPUDelegate {
+        private:
+            static const uint32_t Words = 0x10000 / 64;
+
+            uint64_t executed[Words];
+            uint64_t taken[Words];
+            uint64_t notTaken[Words];
+
+            uint8_t sizes[256];
+
+            static bool IsConditional(uint8_t opcode);
+            static bool Test(const uint64_t * const bitmap, uint16_t addr);
+
+        public:
+            Coverage();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+
+            // Bitmaps
+            bool IsExecuted(uint16_t addr) const;
+            bool IsTaken(uint16_t addr) const;
+            bool IsNotTaken(uint16_t addr) const;
+            void Merge(const Coverage * const other);
+            void Reset();
+
+            // Load/save
+            void SaveToFile(const char * const filename) const;
+            void LoadFromFile(const char * const filename);
+
+            // Reports; memory supplies the code that is disassembled over [start, end].
+            CoverageSummary GetSummary(const CPUState * const state, uint16_t start, uint16_t end) const;
+            std::string ToString(const CPUState * const state, uint16_t start, uint16_t end, const SymbolMap * const symbols = nullptr) const;
+    };
+}
@@ -0,0 +1,256 @@
+#include "Disassembler.h"
+
+#include <string.h>
+
+namespace Emu8080
+{
+    static constexpr uint8_t TextLength(const char * const text)
+    {
+        return *text == 0 ? 0 : 1 + TextLength(text + 1);
+    }
+
+#define Op(text, length, operand) { text, TextLength(text), length, operand }
+
+    static constexpr OperandKind None = OperandKind::None;
+    static constexpr OperandKind Data8 = OperandKind::Data8;
+    static constexpr OperandKind Data16 = OperandKind::Data16;
+    static constexpr OperandKind Port = OperandKind::Port;
+
+    // Undocumented opcodes decode as the instruction the 8080 actually executes for them (0xcb is jmp, 0xd9 ret, ...).
+    constexpr OpcodeInfo OpcodeTable[256] = {
+        /* 00 */ Op("nop", 1, None), Op("lxi b,", 3, Data16), Op("stax b", 1, None), Op("inx b", 1, None),
+        /* 04 */ Op("inr b", 1, None), Op("dcr b", 1, None), Op("mvi b,", 2, Data8), Op("rlc", 1, None),
+        /* 08 */ Op("nop", 1, None), Op("dad b", 1, None), Op("ldax b", 1, None), Op("dcx b", 1, None),
+        /* 0c */ Op("inr c", 1, None), Op("dcr c", 1, None), Op("mvi c,", 2, Data8), Op("rrc", 1, None),
+        /* 10 */ Op("nop", 1, None), Op("lxi d,", 3, Data16), Op("stax d", 1, None), Op("inx d", 1, None),
+        /* 14 */ Op("inr d", 1, None), Op("dcr d", 1, None), Op("mvi d,", 2, Data8), Op("ral", 1, None),
+        /* 18 */ Op("nop", 1, None), Op("dad d", 1, None), Op("ldax d", 1, None), Op("dcx d", 1, None),
+        /* 1c */ Op("inr e", 1, None), Op("dcr e", 1, None), Op("mvi e,", 2, Data8), Op("rar", 1, None),
+        /* 20 */ Op("nop", 1, None), Op("lxi h,", 3, Data16), Op("shld", 3, Data16), Op("inx h", 1, None),
+        /* 24 */ Op("inr h", 1, None), Op("dcr h", 1, None), Op("mvi h,", 2, Data8), Op("daa", 1, None),
+        /* 28 */ Op("nop", 1, None), Op("dad h", 1, None), Op("lhld", 3, Data16), Op("dcx h", 1, None),
+        /* 2c */ Op("inr l", 1, None), Op("dcr l", 1, None), Op("mvi l,", 2, Data8), Op("cma", 1, None),
+        /* 30 */ Op("nop", 1, None), Op("lxi sp,", 3, Data16), Op("sta", 3, Data16), Op("inx sp", 1, None),
+        /* 34 */ Op("inr M", 1, None), Op("dcr M", 1, None), Op("mvi M,", 2, Data8), Op("stc", 1, None),
+        /* 38 */ Op("nop", 1, None), Op("dad sp", 1, None), Op("lda", 3, Data16), Op("dcx sp", 1, None),
+        /* 3c */ Op("inr a", 1, None), Op("dcr a", 1, None), Op("mvi a,", 2, Data8), Op("cmc", 1, None),
+        /* 40 */ Op("mov b, b", 1, None), Op("mov b, c", 1, None), Op("mov b, d", 1, None), Op("mov b, e", 1, None),
+        /* 44 */ Op("mov b, h", 1, None), Op("mov b, l", 1, None), Op("mov b, M", 1, None), Op("mov b, a", 1, None),
+        /* 48 */ Op("mov c, b", 1, None), Op("mov c, c", 1, None), Op("mov c, d", 1, None), Op("mov c, e", 1, None),
+        /* 4c */ Op("mov c, h", 1, None), Op("mov c, l", 1, None), Op("mov c, M", 1, None), Op("mov c, a", 1, None),
+        /* 50 */ Op("mov d, b", 1, None), Op("mov d, c", 1, None), Op("mov d, d", 1, None), Op("mov d, e", 1, None),
+        /* 54 */ Op("mov d, h", 1, None), Op("mov d, l", 1, None), Op("mov d, M", 1, None), Op("mov d, a", 1, None),
+        /* 58 */ Op("mov e, b", 1, None), Op("mov e, c", 1, None), Op("mov e, d", 1, None), Op("mov e, e", 1, None),
+        /* 5c */ Op("mov e, h", 1, None), Op("mov e, l", 1, None), Op("mov e, M", 1, None), Op("mov e, a", 1, None),
+        /* 60 */ Op("mov h, b", 1, None), Op("mov h, c", 1, None), Op("mov h, d", 1, None), Op("mov h, e", 1, None),
+        /* 64 */ Op("mov h, h", 1, None), Op("mov h, l", 1, None), Op("mov h, M", 1, None), Op("mov h, a", 1, None),
+        /* 68 */ Op("mov l, b", 1, None), Op("mov l, c", 1, None), Op("mov l, d", 1, None), Op("mov l, e", 1, None),
+        /* 6c */ Op("mov l, h", 1, None), Op("mov l, l", 1, None), Op("mov l, M", 1, None), Op("mov l, a", 1, None),
+        /* 70 */ Op("mov M, b", 1, None), Op("mov M, c", 1, None), Op("mov M, d", 1, None), Op("mov M, e", 1, None),
+        /* 74 */ Op("mov M, h", 1, None), Op("mov M, l", 1, None), Op("hlt", 1, None), Op("mov M, a", 1, None),
+        /* 78 */ Op("mov a, b", 1, None), Op("mov a, c", 1, None), Op("mov a, d", 1, None), Op("mov a, e", 1, None),
+        /* 7c */ Op("mov a, h", 1, None), Op("mov a, l", 1, None), Op("mov a, M", 1, None), Op("mov a, a", 1, None),
+        /* 80 */ Op("add b", 1, None), Op("add c", 1, None), Op("add d", 1, None), Op("add e", 1, None),
+        /* 84 */ Op("add h", 1, None), Op("add l", 1, None), Op("add M", 1, None), Op("add a", 1, None),
+        /* 88 */ Op("adc b", 1, None), Op("adc c", 1, None), Op("adc d", 1, None), Op("adc e", 1, None),
+        /* 8c */ Op("adc h", 1, None), Op("adc l", 1, None), Op("adc M", 1, None), Op("adc a", 1, None),
+        /* 90 */ Op("sub b", 1, None), Op("sub c", 1, None), Op("sub d", 1, None), Op("sub e", 1, None),
+        /* 94 */ Op("sub h", 1, None), Op("sub l", 1, None), Op("sub M", 1, None), Op("sub a", 1, None),
+        /* 98 */ Op("sbb b", 1, None), Op("sbb c", 1, None), Op("sbb d", 1, None), Op("sbb e", 1, None),
+        /* 9c */ Op("sbb h", 1, None), Op("sbb l", 1, None), Op("sbb M", 1, None), Op("sbb a", 1, None),
+        /* a0 */ Op("ana b", 1, None), Op("ana c", 1, None), Op("ana d", 1, None), Op("ana e", 1, None),
+        /* a4 */ Op("ana h", 1, None), Op("ana l", 1, None), Op("ana M", 1, None), Op("ana a", 1, None),
+        /* a8 */ Op("xra b", 1, None), Op("xra c", 1, None), Op("xra d", 1, None), Op("xra e", 1, None),
+        /* ac */ Op("xra h", 1, None), Op("xra l", 1, None), Op("xra M", 1, None), Op("xra a", 1, None),
+        /* b0 */ Op("ora b", 1, None), Op("ora c", 1, None), Op("ora d", 1, None), Op("ora e", 1, None),
+        /* b4 */ Op("ora h", 1, None), Op("ora l", 1, None), Op("ora M", 1, None), Op("ora a", 1, None),
+        /* b8 */ Op("cmp b", 1, None), Op("cmp c", 1, None), Op("cmp d", 1, None), Op("cmp e", 1, None),
+        /* bc */ Op("cmp h", 1, None), Op("cmp l", 1, None), Op("cmp M", 1, None), Op("cmp a", 1, None),
+        /* c0 */ Op("rnz", 1, None), Op("pop b", 1, None), Op("jnz", 3, Data16), Op("jmp", 3, Data16),
+        /* c4 */ Op("cnz", 3, Data16), Op("push b", 1, None), Op("adi", 2, Data8), Op("rst 0", 1, None),
+        /* c8 */ Op("rz", 1, None), Op("ret", 1, None), Op("jz", 3, Data16), Op("jmp", 3, Data16),
+        /* cc */ Op("cz", 3, Data16), Op("call", 3, Data16), Op("aci", 2, Data8), Op("rst 1", 1, None),
+        /* d0 */ Op("rnc", 1, None), Op("pop d", 1, None), Op("jnc", 3, Data16), Op("out", 2, Port),
+        /* d4 */ Op("cnc", 3, Data16), Op("push d", 1, None), Op("sui", 2, Data8), Op("rst 2", 1, None),
+        /* d8 */ Op("rc", 1, None), Op("ret", 1, None), Op("jc", 3, Data16), Op("in", 2, Port),
+        /* dc */ Op("cc", 3, Data16), Op("call", 3, Data16), Op("sbi", 2, Data8), Op("rst 3", 1, None),
+        /* e0 */ Op("rpo", 1, None), Op("pop h", 1, None), Op("jpo", 3, Data16), Op("xthl", 1, None),
+        /* e4 */ Op("cpo", 3, Data16), Op("push h", 1, None), Op("ani", 2, Data8), Op("rst 4", 1, None),
+        /* e8 */ Op("rpe", 1, None), Op("pchl", 1, None), Op("jpe", 3, Data16), Op("xchg", 1, None),
+        /* ec */ Op("cpe", 3, Data16), Op("call", 3, Data16), Op("xri", 2, Data8), Op("rst 5", 1, None),
+        /* f0 */ Op("rp", 1, None), Op("pop psw", 1, None), Op("jp", 3, Data16), Op("di", 1, None),
+        /* f4 */ Op("cp", 3, Data16), Op("push psw", 1, None), Op("ori", 2, Data8), Op("rst 6", 1, None),
+        /* f8 */ Op("rm", 1, None), Op("sphl", 1, None), Op("jm", 3, Data16), Op("ei", 1, None),
+        /* fc */ Op("cm", 3, Data16), Op("call", 3, Data16), Op("cpi", 2, Data8), Op("rst 7", 1, None),
+    };
+
+#undef Op
+
+    static const char HexDigits[] = "0123456789abcdef";
+
+    static inline char *WriteHex2(char *out, uint8_t value)
+    {
+        *out++ = HexDigits[value >> 4];
+        *out++ = HexDigits[value & 0xF];
+        return out;
+    }
+
+    // Without leading zeros, as FormatString("%x") would.
+    static inline char *WriteHex(char *out, uint16_t value)
+    {
+        int digits = value >= 0x1000 ? 4 : value >= 0x100 ? 3 : value >= 0x10 ? 2 : 1;
+
+        for (int i = digits - 1; i >= 0; i--, value >>= 4)
+            out[i] = HexDigits[value & 0xF];
+
+        return out + digits;
+    }
+
+    static inline char *WriteInstruction(char *out, const uint8_t * const bytes)
+    {
+        const OpcodeInfo &info = OpcodeTable[bytes[0]];
+
+        // Always copying the whole field lets the compiler use fixed-size moves; the caller's buffer has room.
+        memcpy(out, info.text, sizeof(info.text));
+        out += info.textLength;
+
+        switch (info.operand) {
+            case OperandKind::None:
+                break;
+
+            case OperandKind::Port:
+                *out++ = ' ';
+                out = WriteHex(out, bytes[1]);
+                break;
+
+            case OperandKind::Data8:
+                *out++ = ' ';
+                *out++ = '$';
+                out = WriteHex(out, bytes[1]);
+                break;
+
+            case OperandKind::Data16:
+                *out++ = ' ';
+                *out++ = '$';
+                out = WriteHex(out, bytes[1] | bytes[2] << 8);
+                break;
+        }
+
+        return out;
+    }
+
+    uint8_t DisassembleInstruction(const uint8_t * const bytes, char * const buffer)
+    {
+        *WriteInstruction(buffer, bytes) = 0;
+        return OpcodeTable[bytes[0]].length;
+    }
+
+    size_t DisassembleListing(const uint8_t * const memory, uint32_t size, uint32_t * const position, char * const buffer, size_t capacity)
+    {
+        char *out = buffer;
+        const char * const limit = buffer + capacity;
+        uint32_t addr = *position;
+
+        while (addr < size && limit - out >= (ptrdiff_t)MaxListingLine) {
+            const uint8_t *bytes = memory + addr;
+            uint8_t length = OpcodeTable[bytes[0]].length;
+
+            // An instruction cut off by the end of memory is listed as a data byte.
+            if (addr + length > size)
+                length = 1;
+
+            out = WriteHex2(out, addr >> 8);
+            out = WriteHex2(out, addr & 0xFF);
+            *out++ = ' ';
+            *out++ = ' ';
+
+            // Write all three byte columns, then blank the unused ones; cheaper than branching per column.
+            if (addr + 3 <= size) {
+                for (int i = 0; i < 3; i++) {
+                    WriteHex2(out + i * 3, bytes[i]);
+                    out[i * 3 + 2] = ' ';
+                }
+
+                memcpy(out + length * 3, "         ", 9 - length * 3);
+            } else {
+                memset(out, ' ', 9);
+
+                for (int i = 0; i < length; i++)
+                    WriteHex2(out + i * 3, bytes[i]);
+            }
+
+            out += 9;
+            *out++ = ' ';
+
+            if (length < OpcodeTable[bytes[0]].length) {
+                memcpy(out, "db $", 4);
+                out = WriteHex(out + 4, bytes[0]);
+            } else {
+                out = WriteInstruction(out, bytes);
+            }
+
+            *out++ = '\n';
+            addr += length;
+        }
+
+        *position = addr;
+        return out - buffer;
+    }
+
+    size_t DecodeInstructions(const uint8_t * const memory, uint32_t size, uint32_t * const position, uint8_t * const lengths, OperandKind * const kinds, uint16_t * const operands, size_t count)
+    {
+        static const uint16_t OperandMasks[] = { 0, 0xFF, 0xFFFF, 0xFF };
+        static const uint32_t Chunk = 256;
+
+        uint32_t addr = *position;
+        size_t n = 0;
+
+        // Each address depends on the previous instruction's length, so the lengths of a whole chunk are looked
+        // up first, out of that chain; the walk then costs one load per instruction. Away from the end of memory
+        // both operand bytes can be read, and are masked by kind instead of branching on it.
+        while (n < count && addr + Chunk + 3 <= size) {
+            const uint8_t *chunk = memory + addr;
+            uint8_t chunkLengths[Chunk];
+
+            for (uint32_t i = 0; i < Chunk; i++)
+                chunkLengths[i] = OpcodeTable[chunk[i]].length;
+
+            uint32_t offset = 0;
+
+            while (offset < Chunk && n < count) {
+                const uint8_t *bytes = chunk + offset;
+                OperandKind kind = OpcodeTable[bytes[0]].operand;
+
+                lengths[n] = chunkLengths[offset];
+                kinds[n] = kind;
+                operands[n] = (bytes[1] | bytes[2] << 8) & OperandMasks[(int)kind];
+
+                offset += chunkLengths[offset];
+                n++;
+            }
+
+            addr += offset;
+        }
+
+        while (n < count && addr < size) {
+            const uint8_t *bytes = memory + addr;
+            const OpcodeInfo &info = OpcodeTable[bytes[0]];
+
+            if (addr + info.length > size) {
+                lengths[n] = 1;
+                kinds[n] = OperandKind::None;
+                operands[n] = 0;
+            } else {
+                lengths[n] = info.length;
+                kinds[n] = info.operand;
+                operands[n] = info.length == 3 ? bytes[1] | bytes[2] << 8 : info.length == 2 ? bytes[1] : 0;
+            }
+
+            addr += lengths[n];
+            n++;
+        }
+
+        *position = addr;
+        return n;
+    }
+}
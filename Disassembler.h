@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Emu8080
+{
+    enum class OperandKind : uint8_t { None, Data8, Data16, Port };
+
+    // text is the instruction up to its operand ("mvi b,", "jnz", "rst 0"); an operand follows after a space.
+    struct OpcodeInfo {
+        char text[12];
+        uint8_t textLength;
+        uint8_t length;
+        OperandKind operand;
+    };
+
+    extern const OpcodeInfo OpcodeTable[256];
+
+    // Longest instruction text, "lxi sp, $ffff", plus the terminator; and the longest listing line.
+    static const size_t MaxInstructionText = 16;
+    static const size_t MaxListingLine = 32;
+
+    // Writes the instruction at bytes as NUL-terminated text, in the same form as Encode::DecodeInstruction,
+    // and returns its length. Reads OpcodeTable[bytes[0]].length bytes; buffer needs MaxInstructionText.
+    uint8_t DisassembleInstruction(const uint8_t * const bytes, char * const buffer);
+
+    // Writes listing lines ("0100  c3 00 01  jmp $100") for the instructions from *position on, stopping at
+    // the end of memory or when buffer has no room for another line. Returns the number of characters
+    // written (not NUL-terminated) and advances *position. Nothing is allocated, so a whole image can be
+    // listed by calling this in a loop with a fixed buffer.
+    size_t DisassembleListing(const uint8_t * const memory, uint32_t size, uint32_t * const position, char * const buffer, size_t capacity);
+
+    // Decodes up to count instructions from *position on without formatting any text, for scans that only need
+    // the instruction boundaries and operands. Fills lengths, kinds and operands (0 for OperandKind::None),
+    // stopping at the end of memory, and returns the number decoded and advances *position. An instruction cut
+    // off by the end of memory decodes as a one-byte instruction with no operand, like the listing's db.
+    size_t DecodeInstructions(const uint8_t * const memory, uint32_t size, uint32_t * const position, uint8_t * const lengths, OperandKind * const kinds, uint16_t * const operands, size_t count);
+}
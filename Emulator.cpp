@@ -1,7 +1,9 @@
 #include "Emulator.h"
 
 #include <stdexcept>
+#include <chrono>
 #include "Util.h"
+#include "PageStore.h"
 
 #define DEBUG 0
 
@@ -15,7 +17,25 @@ namespace Emu8080
 
     Emulator::Emulator()
     {
-        this->cpu = new CPU(logfunc, 0x10000);
+        // Without a log function the CPU skips formatting its log messages entirely.
+        this->cpu = new CPU(DEBUG ? logfunc : nullptr, 0x10000);
+        this->checkpointer = nullptr;
+        this->rewindBuffer = nullptr;
+        this->opcodeProfiler = nullptr;
+        this->pcProfiler = nullptr;
+        this->callProfiler = nullptr;
+        this->sequenceProfiler = nullptr;
+        this->coverage = nullptr;
+        this->heatmap = nullptr;
+        this->traceWriter = nullptr;
+        this->watchpoints = nullptr;
+
+        this->ioDelegate = nullptr;
+        this->recorder = nullptr;
+        this->replayer = nullptr;
+
+        this->telemetryPublications = 0;
+
         this->ResetState();
     }
 
@@ -24,6 +44,18 @@ namespace Emu8080
         for (auto pair : this->interruptCallbacks)
             delete pair.second;
 
+        delete this->checkpointer;
+        delete this->rewindBuffer;
+        delete this->opcodeProfiler;
+        delete this->pcProfiler;
+        delete this->callProfiler;
+        delete this->sequenceProfiler;
+        delete this->coverage;
+        delete this->heatmap;
+        delete this->traceWriter;
+        delete this->watchpoints;
+        delete this->recorder;
+        delete this->replayer;
         delete this->cpu;
     }
 
@@ -39,20 +71,140 @@ namespace Emu8080
         // for now
         this->cpu->Write8(0x5, 0xC9);
         this->cpu->WritePC(0x100);
+
+        this->cycles = 0;
+        this->pendingInterrupt = -1;
+
+        this->ResetCounters();
     }
 
     void Emulator::Run()
     {
+        while (this->replayer != nullptr && this->replayer->HasEventAt(this->cycles)) {
+            const InputEvent &event = this->replayer->NextEvent();
+
+            switch (event.type) {
+                case InputEvent::Type::SetInputStream: this->input = event.data; break;
+                case InputEvent::Type::AppendInputStream: this->input += event.data; break;
+                case InputEvent::Type::Interrupt: this->pendingInterrupt = event.value; break;
+                default: break;
+            }
+        }
+
+        // Stops before the instruction at a breakpoint, or at the boundary after one that hit a watchpoint.
+        if (this->watchpoints != nullptr && this->cpu->GetState()->GetWaitCycles() == 0 && this->watchpoints->CheckBreakpoint(this->cpu->ReadPC()))
+            return;
+
+        // Interrupts are only taken between instructions, and are logged at the cycle they are taken on.
+        if (this->pendingInterrupt >= 0 && this->cpu->GetState()->GetWaitCycles() == 0) {
+            uint8_t vector = this->pendingInterrupt;
+            this->pendingInterrupt = -1;
+
+            if (this->cpu->Interrupt(vector)) {
+                if (this->recorder != nullptr)
+                    this->recorder->RecordInterrupt(vector);
+
+                this->counters.interrupts++;
+                this->cycles++;
+                return;
+            }
+        }
+
         auto pc = this->cpu->ReadPC();
+        auto state = this->cpu->GetState();
+        bool boundary = state->GetWaitCycles() == 0;
+
+        if (boundary) {
+            bool trapped = false;
 
-        if (this->cpu->GetState()->GetWaitCycles() == 0) {
-            for (auto pair : this->interruptCallbacks) {
-                if (pair.second->GetAddress() == pc)
+            for (const auto &pair : this->interruptCallbacks) {
+                if (pair.second->GetAddress() == pc) {
                     pair.second->Invoke(this);
+
+                    this->counters.callbacks++;
+                    trapped = true;
+                }
             }
+
+            if (trapped)
+                this->counters.traps++;
         }
 
+        // A callback may have halted the CPU, in which case nothing retires this cycle.
+        bool retires = boundary && !state->GetHalt();
+
         this->cpu->ExecuteCycle();
+
+        if (retires)
+            this->counters.instructions++;
+
+        if (this->checkpointer != nullptr)
+            this->checkpointer->Tick(this->cpu->GetState());
+
+        this->cycles++;
+    }
+
+    uint64_t Emulator::RunSlice(uint64_t cycles)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t instructions = this->counters.instructions;
+        uint64_t first = this->cycles;
+
+        while (this->cycles - first < cycles && !this->cpu->GetState()->GetHalt() && !this->IsStopped())
+            this->Run();
+
+        uint64_t count = this->cycles - first;
+
+        this->counters.slices++;
+        this->counters.sliceInstructions += this->counters.instructions - instructions;
+        this->counters.sliceCycles += count;
+        this->counters.hostNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        this->PublishTelemetry();
+        return count;
+    }
+
+    PerformanceCounters Emulator::GetCounters() const
+    {
+        PerformanceCounters counters = this->counters;
+        counters.cycles = this->cycles - this->counterCycleBase;
+        counters.ioInputs = this->cpu->GetInputCount();
+        counters.ioOutputs = this->cpu->GetOutputCount();
+
+        return counters;
+    }
+
+    void Emulator::ResetCounters()
+    {
+        this->counters = PerformanceCounters();
+        this->counterCycleBase = this->cycles;
+        this->cpu->ResetIOCounts();
+    }
+
+    // Must be called from the thread running the emulator; observers read through GetTelemetry.
+    void Emulator::PublishTelemetry()
+    {
+        auto state = this->cpu->GetState();
+
+        TelemetrySnapshot snapshot;
+        snapshot.publications = ++this->telemetryPublications;
+        snapshot.pc = state->GetPC();
+        snapshot.sp = state->GetSP();
+        snapshot.halt = state->GetHalt();
+        snapshot.counters = this->GetCounters();
+
+        this->telemetry.Publish(snapshot);
+    }
+
+    const TelemetryBlock &Emulator::GetTelemetry() const { return this->telemetry; }
+
+    uint64_t Emulator::GetCycleCount() const { return this->cycles; }
+
+    void Emulator::Interrupt(uint8_t vector)
+    {
+        // During replay interrupts come from the log instead.
+        if (this->replayer == nullptr)
+            this->pendingInterrupt = vector & 0b111;
     }
 
     void Emulator::LoadMemoryFromROM(const char * const filename)
@@ -85,6 +237,304 @@ namespace Emu8080
         this->cpu->ReadBytes(address, buffer, size);
     }
 
+    void Emulator::SaveState(const char * const filename)
+    {
+        this->cpu->GetState()->SaveToFile(filename);
+    }
+
+    void Emulator::LoadState(const char * const filename)
+    {
+        // Maps the file straight into the live state instead of going through CPU::SetState, which would copy it.
+        this->cpu->GetState()->LoadFromFile(filename);
+    }
+
+    void Emulator::ShareMemory()
+    {
+        // Can be called again later to fold pages the guest has since written back into the store.
+        this->cpu->GetState()->ShareMemory(PageStore::GetShared());
+    }
+
+    void Emulator::EnableCheckpoints(const std::string &filename, uint64_t intervalCycles)
+    {
+        delete this->checkpointer;
+        this->checkpointer = new Checkpointer(filename, intervalCycles);
+    }
+
+    void Emulator::DisableCheckpoints()
+    {
+        // Waits for an in-flight checkpoint to finish writing.
+        delete this->checkpointer;
+        this->checkpointer = nullptr;
+    }
+
+    const Checkpointer * const Emulator::GetCheckpointer() const { return this->checkpointer; }
+
+    void Emulator::EnableRewind(size_t memoryBudget, uint32_t keyframeInterval)
+    {
+        this->DisableRewind();
+
+        this->rewindBuffer = new RewindBuffer(this->cpu, memoryBudget, keyframeInterval);
+        this->cpu->AddDelegate(this->rewindBuffer);
+    }
+
+    void Emulator::DisableRewind()
+    {
+        if (this->rewindBuffer == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->rewindBuffer);
+
+        delete this->rewindBuffer;
+        this->rewindBuffer = nullptr;
+    }
+
+    RewindBuffer * const Emulator::GetRewindBuffer() { return this->rewindBuffer; }
+
+    void Emulator::EnableOpcodeProfiler(uint32_t sampleInterval)
+    {
+        this->DisableOpcodeProfiler();
+
+        this->opcodeProfiler = new OpcodeProfiler(sampleInterval);
+        this->cpu->AddDelegate(this->opcodeProfiler);
+    }
+
+    void Emulator::DisableOpcodeProfiler()
+    {
+        if (this->opcodeProfiler == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->opcodeProfiler);
+
+        delete this->opcodeProfiler;
+        this->opcodeProfiler = nullptr;
+    }
+
+    OpcodeProfiler * const Emulator::GetOpcodeProfiler() { return this->opcodeProfiler; }
+
+    void Emulator::EnablePCProfiler(uint32_t sampleInterval)
+    {
+        this->DisablePCProfiler();
+
+        this->pcProfiler = new PCProfiler(sampleInterval);
+        this->cpu->AddDelegate(this->pcProfiler);
+    }
+
+    void Emulator::DisablePCProfiler()
+    {
+        if (this->pcProfiler == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->pcProfiler);
+
+        delete this->pcProfiler;
+        this->pcProfiler = nullptr;
+    }
+
+    PCProfiler * const Emulator::GetPCProfiler() { return this->pcProfiler; }
+
+    void Emulator::EnableCallProfiler(size_t maxDepth)
+    {
+        this->DisableCallProfiler();
+
+        this->callProfiler = new CallProfiler(maxDepth);
+        this->cpu->AddDelegate(this->callProfiler);
+    }
+
+    void Emulator::DisableCallProfiler()
+    {
+        if (this->callProfiler == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->callProfiler);
+
+        delete this->callProfiler;
+        this->callProfiler = nullptr;
+    }
+
+    CallProfiler * const Emulator::GetCallProfiler() { return this->callProfiler; }
+
+    void Emulator::EnableSequenceProfiler()
+    {
+        this->DisableSequenceProfiler();
+
+        this->sequenceProfiler = new SequenceProfiler();
+        this->cpu->AddDelegate(this->sequenceProfiler);
+    }
+
+    void Emulator::DisableSequenceProfiler()
+    {
+        if (this->sequenceProfiler == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->sequenceProfiler);
+
+        delete this->sequenceProfiler;
+        this->sequenceProfiler = nullptr;
+    }
+
+    SequenceProfiler * const Emulator::GetSequenceProfiler() { return this->sequenceProfiler; }
+
+    void Emulator::EnableCoverage()
+    {
+        this->DisableCoverage();
+
+        this->coverage = new Coverage();
+        this->cpu->AddDelegate(this->coverage);
+    }
+
+    void Emulator::DisableCoverage()
+    {
+        if (this->coverage == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->coverage);
+
+        delete this->coverage;
+        this->coverage = nullptr;
+    }
+
+    Coverage * const Emulator::GetCoverage() { return this->coverage; }
+
+    void Emulator::EnableHeatmap(uint64_t windowCycles, size_t maxWindows, bool perByte)
+    {
+        this->DisableHeatmap();
+
+        this->heatmap = new MemoryHeatmap(windowCycles, maxWindows, perByte);
+        this->cpu->AddDelegate(this->heatmap);
+    }
+
+    void Emulator::DisableHeatmap()
+    {
+        if (this->heatmap == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->heatmap);
+
+        delete this->heatmap;
+        this->heatmap = nullptr;
+    }
+
+    MemoryHeatmap * const Emulator::GetHeatmap() { return this->heatmap; }
+
+    void Emulator::EnableTrace(const std::string &filename, uint32_t blockSize)
+    {
+        this->DisableTrace();
+
+        this->traceWriter = new TraceWriter(filename, blockSize);
+        this->cpu->AddDelegate(this->traceWriter);
+    }
+
+    // Deleting the writer writes out the last partial block.
+    void Emulator::DisableTrace()
+    {
+        if (this->traceWriter == nullptr)
+            return;
+
+        this->cpu->RemoveDelegate(this->traceWriter);
+
+        delete this->traceWriter;
+        this->traceWriter = nullptr;
+    }
+
+    TraceWriter * const Emulator::GetTraceWriter() { return this->traceWriter; }
+
+    void Emulator::SetBreakpoint(uint16_t addr)
+    {
+        this->SetWatchpoint(addr, 1, Watchpoints::Execute);
+    }
+
+    void Emulator::ClearBreakpoint(uint16_t addr)
+    {
+        this->ClearWatchpoint(addr, 1, Watchpoints::Execute);
+    }
+
+    // Watchpoints are only attached to the CPU while any are set, so an emulator without them pays nothing.
+    void Emulator::SetWatchpoint(uint16_t addr, uint32_t length, uint8_t types)
+    {
+        if (this->watchpoints == nullptr) {
+            this->watchpoints = new Watchpoints();
+            this->cpu->AddDelegate(this->watchpoints);
+        }
+
+        this->watchpoints->Set(addr, length, types);
+    }
+
+    void Emulator::ClearWatchpoint(uint16_t addr, uint32_t length, uint8_t types)
+    {
+        if (this->watchpoints == nullptr)
+            return;
+
+        this->watchpoints->Clear(addr, length, types);
+        this->ReleaseWatchpoints();
+    }
+
+    void Emulator::ClearAllWatchpoints()
+    {
+        if (this->watchpoints == nullptr)
+            return;
+
+        this->watchpoints->Clear(0, 0x10000, Watchpoints::Execute | Watchpoints::Read | Watchpoints::Write);
+        this->ReleaseWatchpoints();
+    }
+
+    void Emulator::ReleaseWatchpoints()
+    {
+        // Kept while stopped so the hit can still be inspected.
+        if (!this->watchpoints->IsEmpty() || this->watchpoints->IsTriggered())
+            return;
+
+        this->cpu->RemoveDelegate(this->watchpoints);
+
+        delete this->watchpoints;
+        this->watchpoints = nullptr;
+    }
+
+    bool Emulator::IsStopped() const
+    {
+        return this->watchpoints != nullptr && this->watchpoints->IsTriggered();
+    }
+
+    const WatchHit * const Emulator::GetWatchHit() const
+    {
+        return this->IsStopped() ? &this->watchpoints->GetHit() : nullptr;
+    }
+
+    void Emulator::Resume()
+    {
+        if (this->watchpoints == nullptr)
+            return;
+
+        this->watchpoints->Resume(this->cpu->ReadPC());
+        this->ReleaseWatchpoints();
+    }
+
+    void Emulator::LoadSymbols(const char * const filename)
+    {
+        this->symbols.LoadFromFile(filename);
+    }
+
+    SymbolMap * const Emulator::GetSymbols() { return &this->symbols; }
+
+    // The CP/M program start, the rst vectors and every address with an interrupt callback.
+    std::vector<uint16_t> Emulator::GetEntryPoints() const
+    {
+        std::vector<uint16_t> entries = { 0x100 };
+
+        for (uint16_t vector = 0; vector < 8; vector++)
+            entries.push_back(vector * 8);
+
+        for (const auto &pair : this->interruptCallbacks)
+            entries.push_back(pair.second->GetAddress());
+
+        return entries;
+    }
+
+    void Emulator::AnalyzeControlFlow(ControlFlowGraph * const graph)
+    {
+        CPUState *state = this->cpu->GetState();
+        graph->Analyze(state->GetMemory(), state->GetMemorySize(), this->GetEntryPoints());
+    }
+
     const std::string Emulator::GetErrorStream(bool clear)
     {
         auto str = this->error;
@@ -105,13 +555,39 @@ namespace Emu8080
         return str;
     }
 
+    const std::string &Emulator::GetInputStream() const
+    {
+        return this->input;
+    }
+
+    const std::string Emulator::ReadInputStream(size_t length)
+    {
+        auto str = this->input.substr(0, length);
+        this->input.erase(0, str.length());
+
+        return str;
+    }
+
+    // Host input is ignored while replaying, since the log supplies it.
     void Emulator::SetInputStream(const std::string &stream)
     {
+        if (this->replayer != nullptr)
+            return;
+
+        if (this->recorder != nullptr)
+            this->recorder->RecordInputStream(stream, false);
+
         this->input = stream;
     }
 
     void Emulator::AppendInputStream(const std::string &string)
     {
+        if (this->replayer != nullptr)
+            return;
+
+        if (this->recorder != nullptr)
+            this->recorder->RecordInputStream(string, true);
+
         this->input += string;
     }
 
@@ -125,6 +601,57 @@ namespace Emu8080
         this->output += string;
     }
 
+    void Emulator::SetIODelegate(IODelegate * const delegate)
+    {
+        this->ioDelegate = delegate;
+
+        if (this->recorder == nullptr && this->replayer == nullptr)
+            this->cpu->SetIODelegate(delegate);
+    }
+
+    void Emulator::StartRecording(const char * const filename)
+    {
+        this->StopRecording();
+        this->StopReplay();
+
+        this->recorder = new InputRecorder(this, filename, this->ioDelegate);
+        this->cpu->SetIODelegate(this->recorder);
+    }
+
+    void Emulator::StopRecording()
+    {
+        if (this->recorder == nullptr)
+            return;
+
+        this->cpu->SetIODelegate(this->ioDelegate);
+
+        delete this->recorder;
+        this->recorder = nullptr;
+    }
+
+    void Emulator::StartReplay(const char * const filename)
+    {
+        this->StopRecording();
+        this->StopReplay();
+
+        this->replayer = new InputReplayer(this, filename);
+        this->cpu->SetIODelegate(this->replayer);
+    }
+
+    void Emulator::StopReplay()
+    {
+        if (this->replayer == nullptr)
+            return;
+
+        this->cpu->SetIODelegate(this->ioDelegate);
+
+        delete this->replayer;
+        this->replayer = nullptr;
+    }
+
+    const InputRecorder * const Emulator::GetRecorder() const { return this->recorder; }
+    const InputReplayer * const Emulator::GetReplayer() const { return this->replayer; }
+
     void Emulator::RegisterInterruptCallback(uint16_t address, InterruptDelegate * const delegate, const std::string &id)
     {
         if (delegate == nullptr)
@@ -4,6 +4,21 @@
 
 #include "CPU.h"
 #include "InterruptCallback.h"
+#include "Checkpointer.h"
+#include "RewindBuffer.h"
+#include "OpcodeProfiler.h"
+#include "PCProfiler.h"
+#include "CallProfiler.h"
+#include "SequenceProfiler.h"
+#include "Watchpoints.h"
+#include "Coverage.h"
+#include "MemoryHeatmap.h"
+#include "TraceWriter.h"
+#include "SymbolMap.h"
+#include "ControlFlowGraph.h"
+#include "InputLog.h"
+#include "PerformanceCounters.h"
+#include "Telemetry.h"
 
 namespace Emu8080
 {
@@ -15,8 +30,37 @@ namespace Emu8080
             std::string output;
             std::string input;
 
+            uint64_t cycles;
+            int16_t pendingInterrupt;
+
+            PerformanceCounters counters;
+            uint64_t counterCycleBase;
+
+            TelemetryBlock telemetry;
+            uint64_t telemetryPublications;
+
+            IODelegate *ioDelegate;
+            InputRecorder *recorder;
+            InputReplayer *replayer;
+
             std::map<std::string, InterruptCallback *> interruptCallbacks;
 
+            Checkpointer *checkpointer;
+            RewindBuffer *rewindBuffer;
+            OpcodeProfiler *opcodeProfiler;
+            PCProfiler *pcProfiler;
+            CallProfiler *callProfiler;
+            SequenceProfiler *sequenceProfiler;
+            Coverage *coverage;
+            MemoryHeatmap *heatmap;
+            TraceWriter *traceWriter;
+
+            SymbolMap symbols;
+
+            Watchpoints *watchpoints;
+
+            void ReleaseWatchpoints();
+
         public:
             Emulator();
             ~Emulator();
@@ -27,15 +71,90 @@ namespace Emu8080
 
             // Run
             void Run();
+            uint64_t RunSlice(uint64_t cycles);
+            uint64_t GetCycleCount() const;
+            void Interrupt(uint8_t vector);
+
+            // Performance counters
+            PerformanceCounters GetCounters() const;
+            void ResetCounters();
+
+            // Telemetry
+            void PublishTelemetry();
+            const TelemetryBlock &GetTelemetry() const;
 
             // Memory I/O
             void LoadMemoryFromROM(const char * const filename);
             void WriteMemory(const uint16_t address, const uint8_t * const bytes, const uint16_t size);
             void ReadMemory(const uint16_t address, uint8_t * const buffer, const uint16_t size);
 
+            // Save states
+            void SaveState(const char * const filename);
+            void LoadState(const char * const filename);
+            void ShareMemory();
+
+            // Checkpoints
+            void EnableCheckpoints(const std::string &filename, uint64_t intervalCycles);
+            void DisableCheckpoints();
+            const Checkpointer * const GetCheckpointer() const;
+
+            // Rewind
+            void EnableRewind(size_t memoryBudget, uint32_t keyframeInterval);
+            void DisableRewind();
+            RewindBuffer * const GetRewindBuffer();
+
+            // Profiling
+            void EnableOpcodeProfiler(uint32_t sampleInterval = 64);
+            void DisableOpcodeProfiler();
+            OpcodeProfiler * const GetOpcodeProfiler();
+            void EnablePCProfiler(uint32_t sampleInterval = 1);
+            void DisablePCProfiler();
+            PCProfiler * const GetPCProfiler();
+            void EnableCallProfiler(size_t maxDepth = 1024);
+            void DisableCallProfiler();
+            CallProfiler * const GetCallProfiler();
+            void EnableSequenceProfiler();
+            void DisableSequenceProfiler();
+            SequenceProfiler * const GetSequenceProfiler();
+
+            // Coverage
+            void EnableCoverage();
+            void DisableCoverage();
+            Coverage * const GetCoverage();
+
+            // Memory heatmap
+            void EnableHeatmap(uint64_t windowCycles, size_t maxWindows = 1024, bool perByte = false);
+            void DisableHeatmap();
+            MemoryHeatmap * const GetHeatmap();
+
+            // Execution trace
+            void EnableTrace(const std::string &filename, uint32_t blockSize = 0x10000);
+            void DisableTrace();
+            TraceWriter * const GetTraceWriter();
+
+            // Breakpoints/watchpoints
+            void SetBreakpoint(uint16_t addr);
+            void ClearBreakpoint(uint16_t addr);
+            void SetWatchpoint(uint16_t addr, uint32_t length, uint8_t types);
+            void ClearWatchpoint(uint16_t addr, uint32_t length, uint8_t types);
+            void ClearAllWatchpoints();
+            bool IsStopped() const;
+            const WatchHit * const GetWatchHit() const;
+            void Resume();
+
+            // Symbols
+            void LoadSymbols(const char * const filename);
+            SymbolMap * const GetSymbols();
+
+            // Static analysis
+            std::vector<uint16_t> GetEntryPoints() const;
+            void AnalyzeControlFlow(ControlFlowGraph * const graph);
+
             // Stream outputs
             const std::string GetErrorStream(bool clear = true);
             const std::string GetOutputStream(bool clear = true);
+            const std::string &GetInputStream() const;
+            const std::string ReadInputStream(size_t length);
 
             // Stream inputs
             void SetInputStream(const std::string &stream);
@@ -44,6 +163,17 @@ namespace Emu8080
             void SetOutputStream(const std::string &stream);
             void AppendOutputStream(const std::string &string);
 
+            // I/O devices
+            void SetIODelegate(IODelegate * const delegate);
+
+            // Record/replay
+            void StartRecording(const char * const filename);
+            void StopRecording();
+            void StartReplay(const char * const filename);
+            void StopReplay();
+            const InputRecorder * const GetRecorder() const;
+            const InputReplayer * const GetReplayer() const;
+
             // Interrupt handlers
             void RegisterInterruptCallback(uint16_t address, InterruptDelegate * const delegate, const std::string &id);
             const InterruptCallback * const GetInterruptCallback(const std::string &id) const;
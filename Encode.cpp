@@ -2,6 +2,7 @@
 
 #include "Util.h"
 #include "CPU.h"
+#include "Disassembler.h"
 
 namespace Emu8080 {
     uint8_t Encode::IsValidConditionCode(const std::string &_str)
@@ -395,7 +396,7 @@ namespace Emu8080 {
         } else if (instr == "sbi") {
             bytes[0] = 0b11011110;
             bytes[1] = arg1;
-            return 1;
+            return 2;
         } else if (instr == "inr") {
             bytes[0] = 0b100 | (arg1 << 3);
             return 1;
@@ -538,7 +539,6 @@ namespace Emu8080 {
         str = TrimSurroundingWhitespace(str);
 
         uint8_t bytes[3] = { 0x00, 0x00, 0x00 };
-        uint8_t count = 1;
 
         std::string instr;
         auto s = str.c_str();
@@ -556,7 +556,7 @@ namespace Emu8080 {
         if (Encode::ExtractArguments(str, format, &arg1, &arg2) == false)
             throw std::runtime_error(FormatString("Failed to read arguments from string '%s'.", str.c_str()));
 
-        BuildInstruction(bytes, instr, format, arg1, arg2);
+        uint8_t count = BuildInstruction(bytes, instr, format, arg1, arg2);
 
         buffer[0] = bytes[0];
         buffer[1] = bytes[1];
@@ -568,71 +568,27 @@ namespace Emu8080 {
 
     std::string Encode::DecodeInstruction(const uint8_t * const bytes, uint8_t *_count)
     {
-        static const char *instructions[] =
-        {
-            "nop", "lxi b,", "stax b", "inx b",
-            "inr b", "dcr b", "mvi b,", "rlc", "nop", "dad b", "ldax b", "dcx b",
-            "inr c", "dcr c", "mvi c,", "rrc", "nop", "lxi d,", "stax d", "inx d",
-            "inr d", "dcr d", "mvi d,", "ral", "nop", "dad d", "ldax d", "dcx d",
-            "inr e", "dcr e", "mvi e,", "rar", "nop", "lxi h,", "shld", "inx h",
-            "inr h", "dcr h", "mvi h,", "daa", "nop", "dad h", "lhld", "dcx h",
-            "inr l", "dcr l", "mvi l,", "cma", "nop", "lxi sp,", "sta", "inx sp",
-            "inr M", "dcr M", "mvi M,", "stc", "nop", "dad sp", "lda", "dcx sp",
-            "inr a", "dcr a", "mvi a,", "cmc", "mov b, b", "mov b, c", "mov b, d",
-            "mov b, e", "mov b, h", "mov b, l", "mov b, M", "mov b, a", "mov c, b", "mov c, c",
-            "mov c, d", "mov c, e", "mov c, h", "mov c, l", "mov c, M", "mov c, a", "mov d, b",
-            "mov d, c", "mov d, d", "mov d, e", "mov d, h", "mov d, l", "mov d, M", "mov d, a",
-            "mov e, b", "mov e, c", "mov e, d", "mov e, e", "mov e, h", "mov e, l", "mov e, M",
-            "mov e, a", "mov h, b", "mov h, c", "mov h, d", "mov h, e", "mov h, h", "mov h, l",
-            "mov h, M", "mov h, a", "mov l, b", "mov l, c", "mov l, d", "mov l, e", "mov l, h",
-            "mov l, l", "mov l, M", "mov l, a", "mov M, b", "mov M, c", "mov M, d", "mov M, e",
-            "mov M, h", "mov M, l", "hlt", "mov M, a", "mov a, b", "mov a, c", "mov a, d",
-            "mov a, e", "mov a, h", "mov a, l", "mov a, M", "mov a, a", "add b", "add c",
-            "add d", "add e", "add h", "add l", "add M", "add a", "adc b", "adc c",
-            "adc d", "adc e", "adc h", "adc l", "adc M", "adc a", "sub b", "sub c",
-            "sub d", "sub e", "sub h", "sub l", "sub M", "sub a", "sbb b", "sbb c",
-            "sbb d", "sbb e", "sbb h", "sbb l", "sbb M", "sbb a", "ana b", "ana c",
-            "ana d", "ana e", "ana h", "ana l", "ana M", "ana a", "xra b", "xra c",
-            "xra d", "xra e", "xra h", "xra l", "xra M", "xra a", "ora b", "ora c",
-            "ora d", "ora e", "ora h", "ora l", "ora M", "ora a", "cmp b", "cmp c",
-            "cmp d", "cmp e", "cmp h", "cmp l", "cmp M", "cmp a", "rnz", "pop b",
-            "jnz", "jmp", "cnz", "push b", "adi", "rst 0", "rz", "ret", "jz",
-            "jmp", "cz", "call", "aci", "rst 1", "rnc", "pop d", "jnc", "out",
-            "cnc", "push d", "sui", "rst 2", "rc", "ret", "jc", "in", "cc",
-            "call", "sbi", "rst 3", "rpo", "pop h", "jpo", "xthl", "cpo", "push h",
-            "ani", "rst 4", "rpe", "pchl", "jpe", "xchg", "cpe", "call", "xri",
-            "rst 5", "rp", "pop psw", "jp", "di", "cp", "push psw", "ori",
-            "rst 6", "rm", "sphl", "jm", "ei", "cm", "call", "cpi", "rst 7"
-        };
-
-        size_t count = 1;
-        uint8_t instruction = bytes[0];
-
-        int32_t immediate = -1;
-
-        if (instruction == 0xD3 || instruction == 0xDB || ((instruction & 0b111) == 0b110 && ((instruction & 0xF0) < 0x40 || (instruction & 0xF0) > 0xB0))) {
-            count = 2;
-            immediate = bytes[1];
-        }
-
-        if (((instruction & 0xCF) == 0x01) || instruction == 0x22 || instruction == 0x32 || instruction == 0x2A || instruction == 0x3A || instruction == 0xC3 || instruction == 0xCB
-         || ((instruction & 0xCF) == 0xC2) || ((instruction & 0xCF) == 0xC4) || ((instruction & 0xCF) == 0xCA) || ((instruction & 0xCF) == 0xCC) || ((instruction & 0xCF) == 0xCD)) {
-            count = 3;
-            immediate = (bytes[1]) | (bytes[2] << 8);
-        }
+        char buffer[MaxInstructionText];
+        uint8_t count = DisassembleInstruction(bytes, buffer);
 
         if (_count != nullptr)
             *_count = count;
 
-        std::string decode = instructions[instruction];
+        return buffer;
+    }
 
-        if (immediate != -1) {
-            if (instruction == 0xD3 || instruction == 0xDB || (instruction & 0xC7) == 0xC7)
-                decode += FormatString(" %x", immediate);
-            else
-                decode += FormatString(" $%x", immediate);
-        }
+    // The opcode with its register operands but without an immediate, e.g. "mvi b" or "jnz".
+    std::string Encode::DecodeMnemonic(uint8_t opcode, uint8_t *_count)
+    {
+        const OpcodeInfo &info = OpcodeTable[opcode];
+        size_t length = info.textLength;
+
+        if (length > 0 && info.text[length - 1] == ',')
+            length--;
+
+        if (_count != nullptr)
+            *_count = info.length;
 
-        return decode;
+        return std::string(info.text, length);
     }
-}
\ No newline at end of file
+}
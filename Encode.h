@@ -27,6 +27,7 @@ namespace Emu8080 {
             // Instruction encoding
             static void EncodeInstruction(const std::string &str, uint8_t * const buffer, uint8_t *size = nullptr);
             static std::string DecodeInstruction(const uint8_t * const bytes, uint8_t *size = nullptr);
+            static std::string DecodeMnemonic(uint8_t opcode, uint8_t *size = nullptr);
 
             // Condition code encoding
             static uint8_t IsValidConditionCode(const std::string &_str);
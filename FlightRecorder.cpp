@@ -0,0 +1,60 @@
+#include "FlightRecorder.h"
+
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    const uint32_t FlightRecorder::Capacity;
+
+    FlightRecorder::FlightRecorder()
+    {
+        this->Clear();
+    }
+
+    std::vector<FlightRecord> FlightRecorder::GetRecords() const
+    {
+        std::vector<FlightRecord> records;
+        uint64_t first = this->count > Capacity ? this->count - Capacity : 0;
+
+        for (uint64_t i = first; i < this->count; i++)
+            records.push_back(this->records[i % Capacity]);
+
+        return records;
+    }
+
+    uint64_t FlightRecorder::GetCount() const { return this->count; }
+
+    void FlightRecorder::Clear()
+    {
+        this->count = 0;
+    }
+
+    // The last line is the instruction that was executing when the fault happened.
+    std::string FlightRecorder::ToString(const std::vector<FlightRecord> &records)
+    {
+        std::string str = "pc   op mnemonic    a  b  c  d  e  h  l  flags    sp\n";
+
+        for (auto &record : records) {
+            str += FormatString("%04x %02x %-10s  %02x %02x %02x %02x %02x %02x %02x %c%c%c%c%c %04x\n", record.pc, record.opcode,
+                Encode::DecodeMnemonic(record.opcode).c_str(), record.registers[0], record.registers[1], record.registers[2],
+                record.registers[3], record.registers[4], record.registers[5], record.registers[6],
+                record.flags & 0x80 ? 'S' : '-', record.flags & 0x40 ? 'Z' : '-', record.flags & 0x10 ? 'A' : '-',
+                record.flags & 0x04 ? 'P' : '-', record.flags & 0x01 ? 'C' : '-', record.sp);
+        }
+
+        return str;
+    }
+
+    CPUFault::CPUFault(const std::string &message, const std::vector<FlightRecord> &records) : std::runtime_error(message)
+    {
+        this->records = records;
+    }
+
+    const std::vector<FlightRecord> &CPUFault::GetRecords() const { return this->records; }
+
+    std::string CPUFault::Dump() const
+    {
+        return FlightRecorder::ToString(this->records);
+    }
+}
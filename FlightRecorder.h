@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "CPUState.h"
+
+namespace Emu8080
+{
+    // Registers as they were before the instruction at pc executed; registers are in CPUState order (a, b, c, d, e, h, l).
+    struct FlightRecord {
+        uint16_t pc;
+        uint16_t sp;
+        uint8_t opcode;
+        uint8_t flags;
+        uint8_t registers[7];
+    };
+
+    // Fixed ring of the last Capacity instructions, filled by the CPU on every instruction.
+    class FlightRecorder {
+        public:
+            static const uint32_t Capacity = 64;
+
+        private:
+            FlightRecord records[Capacity];
+            uint64_t count;
+
+        public:
+            FlightRecorder();
+
+            inline void Record(const CPUState * const state, uint16_t pc, uint8_t opcode)
+            {
+                FlightRecord &record = this->records[this->count++ % Capacity];
+                record.pc = pc;
+                record.sp = state->GetSP();
+                record.opcode = opcode;
+                record.flags = state->GetFlags();
+                memcpy(record.registers, state->GetRegisters(), sizeof(record.registers));
+            }
+
+            // Oldest first.
+            std::vector<FlightRecord> GetRecords() const;
+            uint64_t GetCount() const;
+            void Clear();
+
+            static std::string ToString(const std::vector<FlightRecord> &records);
+    };
+
+    // Thrown by CPU::ExecuteInstruction in place of any error raised while executing, carrying the instructions
+    // leading up to it. what() is the original message.
+    class CPUFault : public std::runtime_error {
+        private:
+            std::vector<FlightRecord> records;
+
+        public:
+            CPUFault(const std::string &message, const std::vector<FlightRecord> &records);
+
+            const std::vector<FlightRecord> &GetRecords() const;
+            std::string Dump() const;
+    };
+}
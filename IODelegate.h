@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "CPUState.h"
+
+namespace Emu8080
+{
+    // Devices see the CPU state rather than the CPU.
+    class IODelegate {
+        public:
+            virtual ~IODelegate() {}
+
+            virtual uint8_t HandleInput(CPUState * const state, uint8_t port) = 0;
+            virtual void HandleOutput(CPUState * const state, uint8_t port, uint8_t data) = 0;
+    };
+}
@@ -0,0 +1,265 @@
+#include "InputLog.h"
+
+#include <stdexcept>
+
+#include "Emulator.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    static const char InputLogMagic[4] = { 'E', '8', '0', 'I' };
+    static const uint8_t InputLogVersion = 1;
+    static const size_t InputLogFlushSize = 0x10000;
+
+    static void WriteVarint(std::vector<uint8_t> &buffer, uint64_t value)
+    {
+        while (value >= 0x80) {
+            buffer.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+
+        buffer.push_back(value);
+    }
+
+    static uint64_t ReadVarint(const std::vector<uint8_t> &buffer, size_t &offset)
+    {
+        uint64_t value = 0;
+
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (offset >= buffer.size())
+                throw std::runtime_error("Input log is truncated.");
+
+            uint8_t byte = buffer[offset++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        throw std::runtime_error("Input log contains a malformed varint.");
+    }
+
+    InputRecorder::InputRecorder(Emulator * const emulator, const char * const filename, IODelegate * const devices)
+    {
+        this->emulator = emulator;
+        this->devices = devices;
+
+        this->file = fopen(filename, "wb");
+
+        if (this->file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        this->buffer.insert(this->buffer.end(), InputLogMagic, InputLogMagic + sizeof(InputLogMagic));
+        this->buffer.push_back(InputLogVersion);
+
+        this->lastCycle = 0;
+        this->eventCount = 0;
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        this->WriteBuffer();
+        fclose(this->file);
+    }
+
+    void InputRecorder::WriteEvent(const InputEvent &event)
+    {
+        // Cycles are stored as deltas from the previous event, which keeps most of them to one byte.
+        WriteVarint(this->buffer, event.cycle - this->lastCycle);
+        this->buffer.push_back((uint8_t)event.type);
+        this->lastCycle = event.cycle;
+
+        switch (event.type) {
+            case InputEvent::Type::SetInputStream:
+            case InputEvent::Type::AppendInputStream: {
+                WriteVarint(this->buffer, event.data.size());
+                this->buffer.insert(this->buffer.end(), event.data.begin(), event.data.end());
+                break;
+            }
+
+            case InputEvent::Type::PortInput: {
+                this->buffer.push_back(event.port);
+                this->buffer.push_back(event.value);
+                break;
+            }
+
+            case InputEvent::Type::Interrupt: {
+                this->buffer.push_back(event.value);
+                break;
+            }
+        }
+
+        this->eventCount++;
+
+        if (this->buffer.size() >= InputLogFlushSize)
+            this->Flush();
+    }
+
+    void InputRecorder::RecordInputStream(const std::string &data, bool append)
+    {
+        InputEvent event;
+        event.cycle = this->emulator->GetCycleCount();
+        event.type = append ? InputEvent::Type::AppendInputStream : InputEvent::Type::SetInputStream;
+        event.data = data;
+
+        this->WriteEvent(event);
+    }
+
+    void InputRecorder::RecordInterrupt(uint8_t vector)
+    {
+        InputEvent event;
+        event.cycle = this->emulator->GetCycleCount();
+        event.type = InputEvent::Type::Interrupt;
+        event.value = vector;
+
+        this->WriteEvent(event);
+    }
+
+    bool InputRecorder::WriteBuffer()
+    {
+        if (this->buffer.empty())
+            return true;
+
+        bool ok = fwrite(this->buffer.data(), 1, this->buffer.size(), this->file) == this->buffer.size() && fflush(this->file) == 0;
+        this->buffer.clear();
+
+        return ok;
+    }
+
+    void InputRecorder::Flush()
+    {
+        if (!this->WriteBuffer())
+            throw std::runtime_error("Failed to write input log.");
+    }
+
+    uint64_t InputRecorder::GetEventCount() const { return this->eventCount; }
+
+    uint8_t InputRecorder::HandleInput(CPUState * const state, uint8_t port)
+    {
+        if (this->devices == nullptr)
+            throw std::runtime_error("no I/O.");
+
+        InputEvent event;
+        event.cycle = this->emulator->GetCycleCount();
+        event.type = InputEvent::Type::PortInput;
+        event.port = port;
+        event.value = this->devices->HandleInput(state, port);
+
+        this->WriteEvent(event);
+        return event.value;
+    }
+
+    void InputRecorder::HandleOutput(CPUState * const state, uint8_t port, uint8_t data)
+    {
+        if (this->devices == nullptr)
+            throw std::runtime_error("no I/O.");
+
+        this->devices->HandleOutput(state, port, data);
+    }
+
+    InputReplayer::InputReplayer(Emulator * const emulator, const char * const filename)
+    {
+        this->emulator = emulator;
+        this->eventIndex = 0;
+        this->portEventIndex = 0;
+
+        FILE *file = fopen(filename, "rb");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        fseek(file, 0, SEEK_END);
+        size_t size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        std::vector<uint8_t> buffer(size);
+        size_t read = fread(buffer.data(), 1, size, file);
+        fclose(file);
+
+        if (read != size || size < sizeof(InputLogMagic) + 1 || memcmp(buffer.data(), InputLogMagic, sizeof(InputLogMagic)) != 0
+         || buffer[sizeof(InputLogMagic)] != InputLogVersion)
+            throw std::runtime_error(FormatString("'%s' is not a valid input log.", filename));
+
+        size_t offset = sizeof(InputLogMagic) + 1;
+        uint64_t cycle = 0;
+
+        while (offset < size) {
+            InputEvent event;
+
+            cycle += ReadVarint(buffer, offset);
+            event.cycle = cycle;
+
+            if (offset >= size)
+                throw std::runtime_error("Input log is truncated.");
+
+            event.type = (InputEvent::Type)buffer[offset++];
+
+            switch (event.type) {
+                case InputEvent::Type::SetInputStream:
+                case InputEvent::Type::AppendInputStream: {
+                    uint64_t length = ReadVarint(buffer, offset);
+
+                    if (length > size - offset)
+                        throw std::runtime_error("Input log is truncated.");
+
+                    event.data.assign((const char *)buffer.data() + offset, length);
+                    offset += length;
+                    break;
+                }
+
+                case InputEvent::Type::PortInput: {
+                    if (size - offset < 2)
+                        throw std::runtime_error("Input log is truncated.");
+
+                    event.port = buffer[offset++];
+                    event.value = buffer[offset++];
+                    break;
+                }
+
+                case InputEvent::Type::Interrupt: {
+                    if (offset >= size)
+                        throw std::runtime_error("Input log is truncated.");
+
+                    event.value = buffer[offset++];
+                    break;
+                }
+
+                default: throw std::runtime_error(FormatString("Unknown input log event type %d.", (int)event.type));
+            }
+
+            if (event.type == InputEvent::Type::PortInput)
+                this->portEvents.push_back(event);
+            else
+                this->events.push_back(event);
+        }
+    }
+
+    const InputEvent &InputReplayer::NextEvent()
+    {
+        return this->events[this->eventIndex++];
+    }
+
+    bool InputReplayer::IsFinished() const
+    {
+        return this->eventIndex == this->events.size() && this->portEventIndex == this->portEvents.size();
+    }
+
+    uint8_t InputReplayer::HandleInput(CPUState * const state, uint8_t port)
+    {
+        if (this->portEventIndex >= this->portEvents.size())
+            throw std::runtime_error(FormatString("Replay diverged: unexpected input from port 0x%x.", port));
+
+        const InputEvent &event = this->portEvents[this->portEventIndex++];
+        uint64_t cycle = this->emulator->GetCycleCount();
+
+        if (event.port != port || event.cycle != cycle)
+            throw std::runtime_error(FormatString("Replay diverged: input from port 0x%x at cycle %llu, recorded port 0x%x at cycle %llu.",
+                port, (unsigned long long)cycle, event.port, (unsigned long long)event.cycle));
+
+        return event.value;
+    }
+
+    void InputReplayer::HandleOutput(CPUState * const state, uint8_t port, uint8_t data)
+    {
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "IODelegate.h"
+
+namespace Emu8080
+{
+    class Emulator;
+
+    struct InputEvent {
+        enum class Type : uint8_t { SetInputStream, AppendInputStream, PortInput, Interrupt };
+
+        uint64_t cycle;
+        Type type;
+        uint8_t port;
+        uint8_t value;
+        std::string data;
+    };
+
+    // Logs every external input of an emulator, keyed by cycle count. Port input is forwarded
+    // to the wrapped delegate and the value it returns is recorded.
+    class InputRecorder : public IODelegate {
+        private:
+            Emulator *emulator;
+            IODelegate *devices;
+
+            FILE *file;
+            std::vector<uint8_t> buffer;
+            uint64_t lastCycle;
+            uint64_t eventCount;
+
+            void WriteEvent(const InputEvent &event);
+            bool WriteBuffer();
+
+        public:
+            InputRecorder(Emulator * const emulator, const char * const filename, IODelegate * const devices);
+            ~InputRecorder();
+
+            // Recording
+            void RecordInputStream(const std::string &data, bool append);
+            void RecordInterrupt(uint8_t vector);
+
+            // Throws if the log can't be written; the destructor writes what is left without throwing.
+            void Flush();
+
+            uint64_t GetEventCount() const;
+
+            // IODelegate
+            uint8_t HandleInput(CPUState * const state, uint8_t port) override;
+            void HandleOutput(CPUState * const state, uint8_t port, uint8_t data) override;
+    };
+
+    // Feeds a recorded log back into an emulator. The whole log is decoded up front, so replay
+    // does no host I/O; port output is discarded.
+    class InputReplayer : public IODelegate {
+        private:
+            Emulator *emulator;
+
+            std::vector<InputEvent> events;
+            std::vector<InputEvent> portEvents;
+            size_t eventIndex;
+            size_t portEventIndex;
+
+        public:
+            InputReplayer(Emulator * const emulator, const char * const filename);
+
+            // Replay
+            inline bool HasEventAt(uint64_t cycle) const { return this->eventIndex < this->events.size() && this->events[this->eventIndex].cycle <= cycle; }
+            const InputEvent &NextEvent();
+            bool IsFinished() const;
+
+            // IODelegate
+            uint8_t HandleInput(CPUState * const state, uint8_t port) override;
+            void HandleOutput(CPUState * const state, uint8_t port, uint8_t data) override;
+    };
+}
@@ -0,0 +1,36 @@
+#include "Lockstep.h"
+
+#include <random>
+
+namespace Emu8080
+{
+    void RandomizeState(CPUState * const state, uint64_t seed, bool allowHalt)
+    {
+        std::mt19937_64 random(seed);
+
+        if (state->GetMemorySize() == 0)
+            state->SetMemorySize(0x10000);
+
+        for (uint32_t addr = 0; addr < state->GetMemorySize(); addr++) {
+            uint8_t byte;
+
+            do {
+                byte = random();
+            } while (byte == 0xD3 || byte == 0xDB || (!allowHalt && byte == 0x76));
+
+            state->WriteByte(addr, byte);
+        }
+
+        for (int i = 0; i < 7; i++)
+            state->SetRegister(i, random());
+
+        // Bits 1, 3 and 5 of the flags register are fixed on the 8080.
+        state->SetFlags((random() & 0b11010101) | 0b10);
+
+        state->SetPC(random());
+        state->SetSP(random());
+        state->SetHalt(false);
+        state->SetInterruptsEnabled(false);
+        state->SetWaitCycles(0);
+    }
+}
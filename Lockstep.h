@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <stdexcept>
+
+#include "CPUState.h"
+#include "StateDiff.h"
+
+namespace Emu8080
+{
+    struct LockstepResult {
+        bool diverged;
+        uint64_t instructions;
+
+        // The checked interval the engines diverged in, valid when diverged is set.
+        uint64_t intervalStart;
+        uint64_t intervalEnd;
+
+        // First divergent instruction, valid when diverged and reproduced are set. If replaying the interval
+        // doesn't reproduce the divergence, one of the engines isn't deterministic and only the bounds are known.
+        bool reproduced;
+        uint64_t divergentInstruction;
+        uint16_t pc;
+        uint8_t opcode;
+
+        StateDiff diff;
+        std::string referenceError;
+        std::string candidateError;
+    };
+
+    // Fills memory with random opcodes (excluding in/out, which need devices) and randomizes the registers.
+    void RandomizeState(CPUState * const state, uint64_t seed, bool allowHalt = false);
+
+    // Runs two engines side by side from the same state and compares them every interval
+    // instructions. On a mismatch both are restored to the last matching checkpoint and replayed
+    // one instruction at a time to find the first divergent instruction. An engine is any type
+    // with GetState() and ExecuteInstruction(), like CPU.
+    template<typename Reference, typename Candidate>
+    class Lockstep {
+        private:
+            Reference *reference;
+            Candidate *candidate;
+            uint32_t interval;
+
+            CPUState referenceCheckpoint;
+            CPUState candidateCheckpoint;
+            uint64_t checkpointInstruction;
+
+            template<typename Engine>
+            static bool Step(Engine * const engine, std::string &error)
+            {
+                try {
+                    engine->ExecuteInstruction();
+                    return true;
+                } catch (const std::exception &e) {
+                    error = e.what();
+                    return false;
+                }
+            }
+
+            bool Matches(const std::string &referenceError, const std::string &candidateError) const
+            {
+                return referenceError == candidateError && this->reference->GetState()->IsEqual(this->candidate->GetState());
+            }
+
+            void Checkpoint(uint64_t instruction)
+            {
+                this->reference->GetState()->CopyTo(&this->referenceCheckpoint);
+                this->candidate->GetState()->CopyTo(&this->candidateCheckpoint);
+                this->checkpointInstruction = instruction;
+            }
+
+            void Bisect(LockstepResult &result)
+            {
+                this->referenceCheckpoint.CopyTo(this->reference->GetState());
+                this->candidateCheckpoint.CopyTo(this->candidate->GetState());
+
+                result.diverged = true;
+                result.intervalStart = this->checkpointInstruction;
+                result.intervalEnd = result.instructions;
+
+                for (uint64_t instruction = this->checkpointInstruction; instruction < result.instructions; instruction++) {
+                    const CPUState *state = this->reference->GetState();
+                    uint16_t pc = state->GetPC();
+                    uint8_t opcode = pc < state->GetMemorySize() ? state->GetMemory()[pc] : 0;
+
+                    std::string referenceError;
+                    std::string candidateError;
+
+                    Step(this->reference, referenceError);
+                    Step(this->candidate, candidateError);
+
+                    if (!this->Matches(referenceError, candidateError)) {
+                        result.reproduced = true;
+                        result.divergentInstruction = instruction;
+                        result.pc = pc;
+                        result.opcode = opcode;
+                        result.referenceError = referenceError;
+                        result.candidateError = candidateError;
+
+                        this->reference->GetState()->Diff(this->candidate->GetState(), &result.diff);
+                        return;
+                    }
+                }
+
+                // The divergence didn't reproduce on replay, so one of the engines isn't deterministic; the diff
+                // is of the states at the end of the replayed interval.
+                this->reference->GetState()->Diff(this->candidate->GetState(), &result.diff);
+            }
+
+        public:
+            Lockstep(Reference * const reference, Candidate * const candidate, uint32_t interval)
+            {
+                this->reference = reference;
+                this->candidate = candidate;
+                this->interval = interval > 0 ? interval : 1;
+                this->checkpointInstruction = 0;
+            }
+
+            LockstepResult Run(uint64_t maxInstructions)
+            {
+                LockstepResult result;
+                result.diverged = false;
+                result.instructions = 0;
+                result.intervalStart = 0;
+                result.intervalEnd = 0;
+                result.reproduced = false;
+                result.divergentInstruction = 0;
+                result.pc = 0;
+                result.opcode = 0;
+                result.diff.Clear();
+
+                this->Checkpoint(0);
+
+                while (result.instructions < maxInstructions) {
+                    std::string referenceError;
+                    std::string candidateError;
+                    bool stopped = false;
+
+                    for (uint32_t i = 0; i < this->interval && result.instructions < maxInstructions; i++) {
+                        if (this->reference->GetState()->GetHalt() || this->candidate->GetState()->GetHalt()) {
+                            stopped = true;
+                            break;
+                        }
+
+                        bool referenceOk = Step(this->reference, referenceError);
+                        bool candidateOk = Step(this->candidate, candidateError);
+                        result.instructions++;
+
+                        if (!referenceOk || !candidateOk) {
+                            stopped = true;
+                            break;
+                        }
+                    }
+
+                    if (!this->Matches(referenceError, candidateError)) {
+                        this->Bisect(result);
+                        return result;
+                    }
+
+                    // Both engines halted or failed identically.
+                    if (stopped) {
+                        result.referenceError = referenceError;
+                        result.candidateError = candidateError;
+                        return result;
+                    }
+
+                    this->Checkpoint(result.instructions);
+                }
+
+                return result;
+            }
+    };
+}
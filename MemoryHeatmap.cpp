@@ -0,0 +1,221 @@
+#include "MemoryHeatmap.h"
+
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    const uint8_t MemoryHeatmap::Execute;
+    const uint8_t MemoryHeatmap::Read;
+    const uint8_t MemoryHeatmap::Write;
+
+    uint32_t HeatmapWindow::GetPagesTouched(uint8_t types) const
+    {
+        uint32_t pages = 0;
+
+        for (int page = 0; page < 0x100; page++) {
+            if (((types & MemoryHeatmap::Execute) && this->executes[page]) || ((types & MemoryHeatmap::Read) && this->reads[page])
+             || ((types & MemoryHeatmap::Write) && this->writes[page]))
+                pages++;
+        }
+
+        return pages;
+    }
+
+    MemoryHeatmap::MemoryHeatmap(uint64_t windowCycles, size_t maxWindows, bool perByte)
+    {
+        this->windowCycles = windowCycles > 0 ? windowCycles : 1;
+        this->windows.resize(maxWindows > 0 ? maxWindows : 1);
+
+        for (int i = 0; i < 3; i++)
+            this->byteCounts[i] = perByte ? new uint32_t[0x10000] : nullptr;
+
+        this->Reset();
+    }
+
+    MemoryHeatmap::~MemoryHeatmap()
+    {
+        for (int i = 0; i < 3; i++)
+            delete[] this->byteCounts[i];
+    }
+
+    // Only guest accesses made by an instruction are counted, not the host loading memory.
+    uint32_t MemoryHeatmap::GetHooks() const { return HookFetch | HookRetire | HookRead | HookWrite; }
+
+    void MemoryHeatmap::WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        this->executing = true;
+        this->current.executes[pc >> 8]++;
+
+        if (this->byteCounts[0] != nullptr)
+            this->byteCounts[0][pc]++;
+    }
+
+    void MemoryHeatmap::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        this->executing = false;
+        this->cycles += cycles;
+
+        if (this->cycles - this->current.startCycle >= this->windowCycles)
+            this->CloseWindow();
+    }
+
+    void MemoryHeatmap::DidReadMemory(const CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (!this->executing)
+            return;
+
+        this->current.reads[addr >> 8]++;
+
+        if (this->byteCounts[1] != nullptr)
+            this->byteCounts[1][addr]++;
+    }
+
+    void MemoryHeatmap::WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (!this->executing)
+            return;
+
+        this->current.writes[addr >> 8]++;
+
+        if (this->byteCounts[2] != nullptr)
+            this->byteCounts[2][addr]++;
+    }
+
+    void MemoryHeatmap::CloseWindow()
+    {
+        this->current.cycles = this->cycles - this->current.startCycle;
+
+        // Once the ring is full the oldest window is overwritten.
+        size_t slot = (this->firstWindow + this->windowCount) % this->windows.size();
+
+        if (this->windowCount == this->windows.size()) {
+            this->firstWindow = (this->firstWindow + 1) % this->windows.size();
+            this->droppedWindows++;
+        } else {
+            this->windowCount++;
+        }
+
+        this->windows[slot] = this->current;
+
+        memset(&this->current, 0, sizeof(this->current));
+        this->current.startCycle = this->cycles;
+    }
+
+    void MemoryHeatmap::Flush()
+    {
+        if (this->cycles > this->current.startCycle)
+            this->CloseWindow();
+    }
+
+    size_t MemoryHeatmap::GetWindowCount() const { return this->windowCount; }
+
+    const HeatmapWindow &MemoryHeatmap::GetWindow(size_t index) const
+    {
+        if (index >= this->windowCount)
+            throw std::runtime_error(FormatString("Window %zu exceeds window count (%zu).", index, this->windowCount));
+
+        return this->windows[(this->firstWindow + index) % this->windows.size()];
+    }
+
+    uint64_t MemoryHeatmap::GetDroppedWindows() const { return this->droppedWindows; }
+
+    uint32_t MemoryHeatmap::GetByteCount(uint16_t addr, uint8_t type) const
+    {
+        int index = type == MemoryHeatmap::Execute ? 0 : type == MemoryHeatmap::Read ? 1 : 2;
+        return this->byteCounts[index] != nullptr ? this->byteCounts[index][addr] : 0;
+    }
+
+    void MemoryHeatmap::Reset()
+    {
+        memset(&this->current, 0, sizeof(this->current));
+
+        this->firstWindow = 0;
+        this->windowCount = 0;
+        this->droppedWindows = 0;
+        this->cycles = 0;
+        this->executing = false;
+
+        for (int i = 0; i < 3; i++) {
+            if (this->byteCounts[i] != nullptr)
+                std::fill(this->byteCounts[i], this->byteCounts[i] + 0x10000, 0);
+        }
+    }
+
+    // One row per window and one column per page, each holding the sum of the selected access types.
+    std::string MemoryHeatmap::ToHeatmapCSV(uint8_t types) const
+    {
+        std::string str = "window,start_cycle";
+
+        for (int page = 0; page < 0x100; page++)
+            str += FormatString(",%02x", page);
+
+        str += "\n";
+
+        for (size_t i = 0; i < this->windowCount; i++) {
+            const HeatmapWindow &window = this->GetWindow(i);
+            str += FormatString("%zu,%llu", i, (unsigned long long)window.startCycle);
+
+            for (int page = 0; page < 0x100; page++) {
+                uint64_t count = 0;
+
+                if (types & MemoryHeatmap::Execute)
+                    count += window.executes[page];
+                if (types & MemoryHeatmap::Read)
+                    count += window.reads[page];
+                if (types & MemoryHeatmap::Write)
+                    count += window.writes[page];
+
+                str += FormatString(",%llu", (unsigned long long)count);
+            }
+
+            str += "\n";
+        }
+
+        return str;
+    }
+
+    // Pages touched per window, plus the cumulative count of distinct pages seen so far.
+    std::string MemoryHeatmap::ToWorkingSetCSV() const
+    {
+        std::string str = "window,start_cycle,cycles,executed,read,written,touched,cumulative\n";
+        bool seen[0x100] = { false };
+        uint32_t cumulative = 0;
+
+        for (size_t i = 0; i < this->windowCount; i++) {
+            const HeatmapWindow &window = this->GetWindow(i);
+
+            for (int page = 0; page < 0x100; page++) {
+                if (!seen[page] && (window.executes[page] || window.reads[page] || window.writes[page])) {
+                    seen[page] = true;
+                    cumulative++;
+                }
+            }
+
+            str += FormatString("%zu,%llu,%llu,%u,%u,%u,%u,%u\n", i, (unsigned long long)window.startCycle, (unsigned long long)window.cycles,
+                window.GetPagesTouched(MemoryHeatmap::Execute), window.GetPagesTouched(MemoryHeatmap::Read), window.GetPagesTouched(MemoryHeatmap::Write),
+                window.GetPagesTouched(MemoryHeatmap::Execute | MemoryHeatmap::Read | MemoryHeatmap::Write), cumulative);
+        }
+
+        return str;
+    }
+
+    // Every address with a nonzero count; empty unless per-byte counting was enabled.
+    std::string MemoryHeatmap::ToByteCSV() const
+    {
+        std::string str = "addr,executes,reads,writes\n";
+
+        if (this->byteCounts[0] == nullptr)
+            return str;
+
+        for (uint32_t addr = 0; addr < 0x10000; addr++) {
+            if (this->byteCounts[0][addr] || this->byteCounts[1][addr] || this->byteCounts[2][addr])
+                str += FormatString("%04x,%u,%u,%u\n", addr, this->byteCounts[0][addr], this->byteCounts[1][addr], this->byteCounts[2][addr]);
+        }
+
+        return str;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CPUDelegate.h"
+
+namespace Emu8080
+{
+    struct HeatmapWindow {
+        uint64_t startCycle;
+        uint64_t cycles;
+        uint32_t reads[0x100];
+        uint32_t writes[0x100];
+        uint32_t executes[0x100];
+
+        uint32_t GetPagesTouched(uint8_t types) const;
+    };
+
+    // Per-page access counters over fixed windows of guest cycles, kept in a ring allocated up front so that
+    // running it costs only counter increments. Per-byte totals are optional.
+    class MemoryHeatmap : public CPUDelegate {
+        private:
+            uint64_t windowCycles;
+
+            std::vector<HeatmapWindow> windows;
+            size_t firstWindow;
+            size_t windowCount;
+            uint64_t droppedWindows;
+
+            HeatmapWindow current;
+            uint64_t cycles;
+            bool executing;
+
+            uint32_t *byteCounts[3];
+
+            void CloseWindow();
+
+        public:
+            // Types, combinable as a mask
+            static const uint8_t Execute = 1 << 0;
+            static const uint8_t Read = 1 << 1;
+            static const uint8_t Write = 1 << 2;
+
+            MemoryHeatmap(uint64_t windowCycles, size_t maxWindows = 1024, bool perByte = false);
+            ~MemoryHeatmap();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+            void DidReadMemory(const CPU * const cpu, uint16_t addr, uint8_t value) override;
+            void WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value) override;
+
+            // Windows, oldest first; Flush closes the partial window in progress.
+            void Flush();
+            size_t GetWindowCount() const;
+            const HeatmapWindow &GetWindow(size_t index) const;
+            uint64_t GetDroppedWindows() const;
+            uint32_t GetByteCount(uint16_t addr, uint8_t type) const;
+            void Reset();
+
+            // Export (CSV)
+            std::string ToHeatmapCSV(uint8_t types = Execute | Read | Write) const;
+            std::string ToWorkingSetCSV() const;
+            std::string ToByteCSV() const;
+    };
+}
@@ -0,0 +1,154 @@
+#include "OpcodeProfiler.h"
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Util.h"
+#include "Encode.h"
+
+namespace Emu8080
+{
+    // Cheapest monotonic tick counter available on the host; units are host specific.
+    static inline uint64_t ReadCycleCounter()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    double OpcodeProfile::GetAverageTicks() const
+    {
+        return this->samples > 0 ? (double)this->sampledTicks / this->samples : 0;
+    }
+
+    OpcodeProfiler::OpcodeProfiler(uint32_t sampleInterval)
+    {
+        this->sampleInterval = sampleInterval > 0 ? sampleInterval : 1;
+
+        // Cost of the two counter reads alone, taken off every sample so cheap handlers don't all look alike.
+        uint64_t best = UINT64_MAX;
+
+        for (int i = 0; i < 64; i++) {
+            uint64_t start = ReadCycleCounter();
+            best = std::min(best, ReadCycleCounter() - start);
+        }
+
+        this->overhead = best;
+        this->Reset();
+    }
+
+    uint32_t OpcodeProfiler::GetHooks() const { return HookFetch | HookRetire; }
+
+    void OpcodeProfiler::WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        if (--this->untilSample > 0)
+            return;
+
+        this->untilSample = this->sampleInterval;
+        this->sampling = true;
+        this->sampleStart = ReadCycleCounter();
+    }
+
+    void OpcodeProfiler::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        if (this->sampling) {
+            uint64_t ticks = ReadCycleCounter() - this->sampleStart;
+
+            this->sampledTicks[opcode] += ticks > this->overhead ? ticks - this->overhead : 0;
+            this->samples[opcode]++;
+            this->sampling = false;
+        }
+
+        this->counts[opcode]++;
+        this->cycles[opcode] += cycles;
+    }
+
+    OpcodeProfile OpcodeProfiler::GetProfile(uint8_t opcode) const
+    {
+        OpcodeProfile profile;
+        profile.opcode = opcode;
+        profile.count = this->counts[opcode];
+        profile.cycles = this->cycles[opcode];
+        profile.samples = this->samples[opcode];
+        profile.sampledTicks = this->sampledTicks[opcode];
+
+        return profile;
+    }
+
+    uint64_t OpcodeProfiler::GetTotalCount() const
+    {
+        uint64_t total = 0;
+
+        for (int i = 0; i < 256; i++)
+            total += this->counts[i];
+
+        return total;
+    }
+
+    // Sorted by estimated host cost (count times average sampled ticks), then by count for opcodes never sampled.
+    std::string OpcodeProfiler::ToString(size_t limit) const
+    {
+        std::vector<OpcodeProfile> profiles;
+
+        for (int i = 0; i < 256; i++) {
+            if (this->counts[i] > 0)
+                profiles.push_back(this->GetProfile(i));
+        }
+
+        std::sort(profiles.begin(), profiles.end(), [](const OpcodeProfile &a, const OpcodeProfile &b) {
+            double costA = a.count * a.GetAverageTicks(), costB = b.count * b.GetAverageTicks();
+            return costA != costB ? costA > costB : a.count > b.count;
+        });
+
+        if (limit > 0 && profiles.size() > limit)
+            profiles.resize(limit);
+
+        uint64_t total = this->GetTotalCount();
+        double totalCost = 0;
+
+        for (int i = 0; i < 256; i++) {
+            OpcodeProfile profile = this->GetProfile(i);
+            totalCost += profile.count * profile.GetAverageTicks();
+        }
+
+        std::string str = FormatString("%-4s %-10s %14s %7s %14s %10s %10s %7s\n", "op", "mnemonic", "count", "count%", "cycles", "samples", "avg ticks", "cost%");
+
+        for (auto &profile : profiles) {
+            double cost = profile.count * profile.GetAverageTicks();
+            std::string mnemonic = Encode::DecodeMnemonic(profile.opcode);
+
+            str += FormatString("0x%02x %-10s %14llu %6.2f%% %14llu %10llu %10.1f %6.2f%%\n", profile.opcode, mnemonic.c_str(),
+                (unsigned long long)profile.count, total > 0 ? profile.count * 100.0 / total : 0, (unsigned long long)profile.cycles,
+                (unsigned long long)profile.samples, profile.GetAverageTicks(), totalCost > 0 ? cost * 100 / totalCost : 0);
+        }
+
+        return str;
+    }
+
+    void OpcodeProfiler::Reset()
+    {
+        for (int i = 0; i < 256; i++) {
+            this->counts[i] = 0;
+            this->cycles[i] = 0;
+            this->samples[i] = 0;
+            this->sampledTicks[i] = 0;
+        }
+
+        this->untilSample = this->sampleInterval;
+        this->sampling = false;
+        this->sampleStart = 0;
+    }
+
+    uint32_t OpcodeProfiler::GetSampleInterval() const { return this->sampleInterval; }
+}
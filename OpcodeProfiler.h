@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "CPUDelegate.h"
+
+namespace Emu8080
+{
+    struct OpcodeProfile {
+        uint8_t opcode;
+        uint64_t count;
+        uint64_t cycles;
+        uint64_t samples;
+        uint64_t sampledTicks;
+
+        double GetAverageTicks() const;
+    };
+
+    // Counts every instruction, and every sampleInterval-th one times the host ticks from WillExecuteInstruction
+    // to DidExecuteInstruction. Delegates called between the two (fetch hooks added after this one, retire hooks
+    // added before it, and memory hooks) are inside that span, so sampled ticks are only comparable across runs
+    // with the same delegates attached.
+    class OpcodeProfiler : public CPUDelegate {
+        private:
+            uint64_t counts[256];
+            uint64_t cycles[256];
+            uint64_t samples[256];
+            uint64_t sampledTicks[256];
+
+            uint32_t sampleInterval;
+            uint32_t untilSample;
+
+            bool sampling;
+            uint64_t sampleStart;
+            uint64_t overhead;
+
+        public:
+            OpcodeProfiler(uint32_t sampleInterval = 64);
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+
+            // Results
+            OpcodeProfile GetProfile(uint8_t opcode) const;
+            uint64_t GetTotalCount() const;
+            std::string ToString(size_t limit = 0) const;
+            void Reset();
+
+            // Info
+            uint32_t GetSampleInterval() const;
+    };
+}
@@ -0,0 +1,144 @@
+#include "PCProfiler.h"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    PCProfiler::PCProfiler(uint32_t sampleInterval)
+    {
+        this->cycles = new uint64_t[0x10000];
+        this->samples = new uint64_t[0x10000];
+        this->sampleInterval = sampleInterval > 0 ? sampleInterval : 1;
+
+        this->Reset();
+    }
+
+    PCProfiler::~PCProfiler()
+    {
+        delete[] this->cycles;
+        delete[] this->samples;
+    }
+
+    uint32_t PCProfiler::GetHooks() const { return HookRetire; }
+
+    void PCProfiler::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        if (--this->untilSample > 0)
+            return;
+
+        this->untilSample = this->sampleInterval;
+        this->cycles[pc] += cycles;
+        this->samples[pc]++;
+    }
+
+    uint64_t PCProfiler::GetCycles(uint16_t pc) const { return this->cycles[pc]; }
+    uint64_t PCProfiler::GetSamples(uint16_t pc) const { return this->samples[pc]; }
+
+    uint64_t PCProfiler::GetTotalCycles() const
+    {
+        uint64_t total = 0;
+
+        for (uint32_t pc = 0; pc < 0x10000; pc++)
+            total += this->cycles[pc];
+
+        return total;
+    }
+
+    // Routines sorted by sampled cycles. Without symbols every address is its own routine.
+    std::string PCProfiler::ToString(const SymbolMap * const symbols, size_t limit) const
+    {
+        struct Routine {
+            std::string name;
+            uint64_t cycles;
+            uint64_t samples;
+        };
+
+        std::map<std::string, Routine> routines;
+
+        for (uint32_t pc = 0; pc < 0x10000; pc++) {
+            if (this->samples[pc] == 0)
+                continue;
+
+            const Symbol *symbol = symbols != nullptr ? symbols->Lookup(pc) : nullptr;
+            std::string name = symbol != nullptr ? symbol->name : FormatString("0x%04x", pc);
+
+            Routine &routine = routines[name];
+            routine.name = name;
+            routine.cycles += this->cycles[pc];
+            routine.samples += this->samples[pc];
+        }
+
+        std::vector<Routine> sorted;
+        for (auto &pair : routines)
+            sorted.push_back(pair.second);
+
+        std::sort(sorted.begin(), sorted.end(), [](const Routine &a, const Routine &b) { return a.cycles > b.cycles; });
+
+        if (limit > 0 && sorted.size() > limit)
+            sorted.resize(limit);
+
+        uint64_t total = this->GetTotalCycles();
+        std::string str = FormatString("%-24s %14s %7s %12s\n", "routine", "cycles", "cycles%", "samples");
+
+        for (auto &routine : sorted) {
+            str += FormatString("%-24s %14llu %6.2f%% %12llu\n", routine.name.c_str(), (unsigned long long)routine.cycles,
+                total > 0 ? routine.cycles * 100.0 / total : 0, (unsigned long long)routine.samples);
+        }
+
+        return str;
+    }
+
+    // One "routine[;address] cycles" line per sampled location, the input flamegraph.pl and speedscope expect.
+    std::string PCProfiler::ToFoldedStacks(const SymbolMap * const symbols, bool addresses) const
+    {
+        std::map<std::string, uint64_t> stacks;
+
+        for (uint32_t pc = 0; pc < 0x10000; pc++) {
+            if (this->cycles[pc] == 0)
+                continue;
+
+            const Symbol *symbol = symbols != nullptr ? symbols->Lookup(pc) : nullptr;
+            std::string stack = symbol != nullptr ? symbol->name : "[unknown]";
+
+            if (addresses || symbol == nullptr)
+                stack += FormatString(";0x%04x", pc);
+
+            stacks[stack] += this->cycles[pc];
+        }
+
+        std::string str;
+
+        for (auto &pair : stacks)
+            str += FormatString("%s %llu\n", pair.first.c_str(), (unsigned long long)pair.second);
+
+        return str;
+    }
+
+    void PCProfiler::WriteFoldedStacks(const char * const filename, const SymbolMap * const symbols, bool addresses) const
+    {
+        FILE *file = fopen(filename, "w");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        std::string str = this->ToFoldedStacks(symbols, addresses);
+        fwrite(str.data(), 1, str.size(), file);
+        fclose(file);
+    }
+
+    void PCProfiler::Reset()
+    {
+        std::fill(this->cycles, this->cycles + 0x10000, 0);
+        std::fill(this->samples, this->samples + 0x10000, 0);
+
+        this->untilSample = this->sampleInterval;
+    }
+
+    uint32_t PCProfiler::GetSampleInterval() const { return this->sampleInterval; }
+}
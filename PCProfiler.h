@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "CPUDelegate.h"
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    class PCProfiler : public CPUDelegate {
+        private:
+            uint64_t *cycles;
+            uint64_t *samples;
+
+            uint32_t sampleInterval;
+            uint32_t untilSample;
+
+        public:
+            PCProfiler(uint32_t sampleInterval = 1);
+            ~PCProfiler();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+
+            // Results
+            uint64_t GetCycles(uint16_t pc) const;
+            uint64_t GetSamples(uint16_t pc) const;
+            uint64_t GetTotalCycles() const;
+            std::string ToString(const SymbolMap * const symbols = nullptr, size_t limit = 0) const;
+            std::string ToFoldedStacks(const SymbolMap * const symbols = nullptr, bool addresses = false) const;
+            void WriteFoldedStacks(const char * const filename, const SymbolMap * const symbols = nullptr, bool addresses = false) const;
+            void Reset();
+
+            // Info
+            uint32_t GetSampleInterval() const;
+    };
+}
@@ -0,0 +1,212 @@
+#include "PageStore.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    const size_t PageStore::NoSlot;
+
+    PageStore::PageStore()
+    {
+        const char *dir = getenv("TMPDIR");
+        std::string path = std::string(dir != nullptr ? dir : "/tmp") + "/emu8080-pages-XXXXXX";
+
+        this->fd = mkstemp(&path[0]);
+
+        if (this->fd < 0)
+            throw std::runtime_error(FormatString("Failed to create page store '%s'.", path.c_str()));
+
+        unlink(path.c_str());
+
+        this->pageSize = sysconf(_SC_PAGESIZE);
+        this->uniquePages = 0;
+        this->totalReferences = 0;
+    }
+
+    PageStore::~PageStore()
+    {
+        close(this->fd);
+    }
+
+    PageStore * const PageStore::GetShared()
+    {
+        static PageStore store;
+        return &store;
+    }
+
+    bool PageStore::SlotMatches(size_t slot, const uint8_t * const page) const
+    {
+        std::vector<uint8_t> buffer(this->pageSize);
+
+        if (pread(this->fd, buffer.data(), this->pageSize, this->GetSlotOffset(slot)) != (ssize_t)this->pageSize)
+            return false;
+
+        return memcmp(buffer.data(), page, this->pageSize) == 0;
+    }
+
+    bool PageStore::RunMatches(size_t first, size_t count, const uint8_t * const pages) const
+    {
+        if (first + count > this->references.size())
+            return false;
+
+        for (size_t i = 0; i < count; i++) {
+            if (this->references[first + i] == 0 || !this->SlotMatches(first + i, pages + i * this->pageSize))
+                return false;
+        }
+
+        return true;
+    }
+
+    void PageStore::Store(size_t slot, const uint8_t * const page, uint64_t hash)
+    {
+        if (pwrite(this->fd, page, this->pageSize, this->GetSlotOffset(slot)) != (ssize_t)this->pageSize)
+            throw std::runtime_error("Failed to write page store.");
+
+        this->hashes[slot] = hash;
+        this->references[slot] = 1;
+        this->index.insert(std::make_pair(hash, slot));
+
+        this->uniquePages++;
+        this->totalReferences++;
+    }
+
+    size_t PageStore::Intern(const uint8_t * const page, size_t hint)
+    {
+        uint64_t hash = HashBytes(page, this->pageSize);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (hint < this->references.size() && this->references[hint] > 0 && this->hashes[hint] == hash && this->SlotMatches(hint, page)) {
+            this->references[hint]++;
+            this->totalReferences++;
+
+            return hint;
+        }
+
+        auto range = this->index.equal_range(hash);
+
+        for (auto it = range.first; it != range.second; it++) {
+            if (this->SlotMatches(it->second, page)) {
+                this->references[it->second]++;
+                this->totalReferences++;
+
+                return it->second;
+            }
+        }
+
+        size_t slot;
+
+        if (!this->freeSlots.empty()) {
+            slot = this->freeSlots.back();
+            this->freeSlots.pop_back();
+        } else {
+            slot = this->hashes.size();
+
+            if (ftruncate(this->fd, this->GetSlotOffset(slot + 1)) != 0)
+                throw std::runtime_error("Failed to grow page store.");
+
+            this->hashes.push_back(0);
+            this->references.push_back(0);
+        }
+
+        this->Store(slot, page, hash);
+
+        return slot;
+    }
+
+    size_t PageStore::InternRun(const uint8_t * const pages, size_t count)
+    {
+        uint64_t hash = HashBytes(pages, count * this->pageSize);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        auto range = this->runIndex.equal_range(hash);
+
+        for (auto it = range.first; it != range.second;) {
+            size_t first = it->second.first;
+
+            if (it->second.second != count || !this->RunMatches(first, count, pages)) {
+                // Slots of a released run get reused, so drop runs that no longer hold their pages.
+                if (it->second.second == count)
+                    it = this->runIndex.erase(it);
+                else
+                    it++;
+
+                continue;
+            }
+
+            for (size_t i = 0; i < count; i++)
+                this->references[first + i]++;
+
+            this->totalReferences += count;
+
+            return first;
+        }
+
+        // Free slots are scattered, so a new run always goes at the end of the file.
+        size_t first = this->hashes.size();
+
+        if (ftruncate(this->fd, this->GetSlotOffset(first + count)) != 0)
+            throw std::runtime_error("Failed to grow page store.");
+
+        this->hashes.resize(first + count, 0);
+        this->references.resize(first + count, 0);
+
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *page = pages + i * this->pageSize;
+            this->Store(first + i, page, HashBytes(page, this->pageSize));
+        }
+
+        this->runIndex.insert(std::make_pair(hash, std::make_pair(first, count)));
+
+        return first;
+    }
+
+    void PageStore::Release(size_t slot)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (slot >= this->references.size() || this->references[slot] == 0)
+            throw std::runtime_error(FormatString("Page store slot %zu is not referenced.", slot));
+
+        this->totalReferences--;
+
+        if (--this->references[slot] > 0)
+            return;
+
+        // Nobody maps the slot anymore, so its contents can be overwritten by the next new page.
+        auto range = this->index.equal_range(this->hashes[slot]);
+
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second == slot) {
+                this->index.erase(it);
+                break;
+            }
+        }
+
+        this->freeSlots.push_back(slot);
+        this->uniquePages--;
+    }
+
+    int PageStore::GetFileDescriptor() const { return this->fd; }
+    size_t PageStore::GetPageSize() const { return this->pageSize; }
+    size_t PageStore::GetSlotOffset(size_t slot) const { return slot * this->pageSize; }
+
+    size_t PageStore::GetUniquePageCount() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->uniquePages;
+    }
+
+    size_t PageStore::GetReferenceCount() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->totalReferences;
+    }
+}
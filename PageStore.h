@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Emu8080
+{
+    // Process-wide store of read-only memory pages, deduplicated by content. Pages live in an
+    // unlinked temporary file, so states can map them copy-on-write straight into their memory.
+    class PageStore {
+        private:
+            int fd;
+            size_t pageSize;
+
+            std::vector<uint64_t> hashes;
+            std::vector<uint32_t> references;
+            std::vector<size_t> freeSlots;
+            std::unordered_multimap<uint64_t, size_t> index;
+            std::unordered_multimap<uint64_t, std::pair<size_t, size_t>> runIndex;
+
+            size_t uniquePages;
+            size_t totalReferences;
+
+            mutable std::mutex mutex;
+
+            bool SlotMatches(size_t slot, const uint8_t * const page) const;
+            bool RunMatches(size_t first, size_t count, const uint8_t * const pages) const;
+            void Store(size_t slot, const uint8_t * const page, uint64_t hash);
+
+        public:
+            PageStore();
+            ~PageStore();
+
+            static PageStore * const GetShared();
+
+            static const size_t NoSlot = SIZE_MAX;
+
+            // Pages; Intern takes the hint slot when it holds the page, so consecutive pages tend to land in
+            // consecutive slots. InternRun returns the first of count consecutive slots holding the pages, reusing an
+            // earlier run with the same contents.
+            size_t Intern(const uint8_t * const page, size_t hint = NoSlot);
+            size_t InternRun(const uint8_t * const pages, size_t count);
+            void Release(size_t slot);
+
+            int GetFileDescriptor() const;
+            size_t GetPageSize() const;
+            size_t GetSlotOffset(size_t slot) const;
+
+            // Stats
+            size_t GetUniquePageCount() const;
+            size_t GetReferenceCount() const;
+    };
+}
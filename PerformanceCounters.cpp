@@ -0,0 +1,27 @@
+#include "PerformanceCounters.h"
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    double PerformanceCounters::GetMIPS() const
+    {
+        return this->hostNanoseconds > 0 ? this->sliceInstructions * 1000.0 / this->hostNanoseconds : 0;
+    }
+
+    double PerformanceCounters::GetGuestMHz() const
+    {
+        return this->hostNanoseconds > 0 ? this->sliceCycles * 1000.0 / this->hostNanoseconds : 0;
+    }
+
+    std::string PerformanceCounters::ToJSON() const
+    {
+        return FormatString("{\"instructions\":%llu,\"cycles\":%llu,\"traps\":%llu,\"callbacks\":%llu,\"interrupts\":%llu,"
+            "\"io_inputs\":%llu,\"io_outputs\":%llu,\"slices\":%llu,\"slice_instructions\":%llu,\"slice_cycles\":%llu,"
+            "\"host_ns\":%llu,\"mips\":%.3f,\"guest_mhz\":%.3f}",
+            (unsigned long long)this->instructions, (unsigned long long)this->cycles, (unsigned long long)this->traps,
+            (unsigned long long)this->callbacks, (unsigned long long)this->interrupts, (unsigned long long)this->ioInputs,
+            (unsigned long long)this->ioOutputs, (unsigned long long)this->slices, (unsigned long long)this->sliceInstructions,
+            (unsigned long long)this->sliceCycles, (unsigned long long)this->hostNanoseconds, this->GetMIPS(), this->GetGuestMHz());
+    }
+}
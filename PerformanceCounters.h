@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace Emu8080
+{
+    struct PerformanceCounters {
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t traps;
+        uint64_t callbacks;
+        uint64_t interrupts;
+        uint64_t ioInputs;
+        uint64_t ioOutputs;
+
+        // Work done inside Emulator::RunSlice, the only place host time is measured.
+        uint64_t slices;
+        uint64_t sliceInstructions;
+        uint64_t sliceCycles;
+        uint64_t hostNanoseconds;
+
+        double GetMIPS() const;
+        double GetGuestMHz() const;
+        std::string ToJSON() const;
+    };
+}
@@ -0,0 +1,201 @@
+#include "RewindBuffer.h"
+
+#include "CPU.h"
+
+namespace Emu8080
+{
+    RewindBuffer::RewindBuffer(CPU * const cpu, size_t memoryBudget, uint32_t keyframeInterval)
+    {
+        this->cpu = cpu;
+        this->memoryBudget = memoryBudget;
+        this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+
+        this->position = 0;
+        this->oldestPosition = 0;
+
+        this->keyframeUsage = 0;
+    }
+
+    RewindBuffer::~RewindBuffer()
+    {
+        this->Clear();
+    }
+
+    uint32_t RewindBuffer::GetHooks() const { return HookFetch | HookWrite; }
+
+    void RewindBuffer::WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        const CPUState *state = cpu->GetState();
+
+        if (this->position % this->keyframeInterval == 0 && (this->keyframes.empty() || this->keyframes.back().position != this->position))
+            this->PushKeyframe(state);
+
+        UndoRecord record;
+        record.pc = pc;
+        record.sp = state->GetSP();
+
+        for (int i = 0; i < 7; i++)
+            record.registers[i] = state->GetRegister(i);
+
+        record.flags = state->GetFlags();
+        record.halt = state->GetHalt();
+        record.interuptsEnabled = state->GetInteruptsEnabled();
+        record.writeCount = 0;
+
+        this->records.push_back(record);
+        this->position++;
+
+        this->Trim();
+    }
+
+    void RewindBuffer::WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        // Writes before the first recorded instruction have nothing to undo into.
+        if (this->records.empty())
+            return;
+
+        MemoryUndo undo;
+        undo.addr = addr;
+        undo.value = cpu->GetState()->GetMemory()[addr];
+
+        this->writes.push_back(undo);
+        this->records.back().writeCount++;
+    }
+
+    void RewindBuffer::PushKeyframe(const CPUState * const state)
+    {
+        Keyframe keyframe;
+        keyframe.position = this->position;
+        keyframe.state = new CPUState();
+
+        state->CopyTo(keyframe.state);
+        this->keyframes.push_back(keyframe);
+
+        this->keyframeUsage += sizeof(CPUState) + keyframe.state->GetMemorySize();
+    }
+
+    void RewindBuffer::PopKeyframe(bool front)
+    {
+        Keyframe &keyframe = front ? this->keyframes.front() : this->keyframes.back();
+
+        this->keyframeUsage -= sizeof(CPUState) + keyframe.state->GetMemorySize();
+        delete keyframe.state;
+
+        if (front)
+            this->keyframes.pop_front();
+        else
+            this->keyframes.pop_back();
+    }
+
+    void RewindBuffer::Trim()
+    {
+        while (this->records.size() > 1 && this->GetMemoryUsage() > this->memoryBudget) {
+            const UndoRecord &record = this->records.front();
+
+            for (uint16_t i = 0; i < record.writeCount; i++)
+                this->writes.pop_front();
+
+            this->records.pop_front();
+            this->oldestPosition++;
+
+            // A keyframe is only useful while some record still lies before it.
+            while (!this->keyframes.empty() && this->keyframes.front().position < this->oldestPosition)
+                this->PopKeyframe(true);
+        }
+    }
+
+    void RewindBuffer::Undo()
+    {
+        const UndoRecord &record = this->records.back();
+        CPUState *state = this->cpu->GetState();
+
+        // Undo entries are written straight to the state so they aren't recorded again.
+        for (uint16_t i = 0; i < record.writeCount; i++) {
+            const MemoryUndo &undo = this->writes.back();
+            state->WriteByte(undo.addr, undo.value);
+            this->writes.pop_back();
+        }
+
+        state->SetPC(record.pc);
+        state->SetSP(record.sp);
+
+        for (int i = 0; i < 7; i++)
+            state->SetRegister(i, record.registers[i]);
+
+        state->SetFlags(record.flags);
+        state->SetHalt(record.halt);
+        state->SetInterruptsEnabled(record.interuptsEnabled);
+        state->SetWaitCycles(0);
+
+        this->records.pop_back();
+        this->position--;
+
+        while (!this->keyframes.empty() && this->keyframes.back().position > this->position)
+            this->PopKeyframe(false);
+    }
+
+    bool RewindBuffer::StepBack()
+    {
+        if (this->records.empty())
+            return false;
+
+        this->Undo();
+        return true;
+    }
+
+    bool RewindBuffer::RewindTo(uint64_t position)
+    {
+        if (position < this->oldestPosition || position > this->position)
+            return false;
+
+        if (position == this->position)
+            return true;
+
+        // Jump to the first keyframe at or after the target, then undo the remaining instructions.
+        for (auto keyframe = this->keyframes.begin(); keyframe != this->keyframes.end(); keyframe++) {
+            if (keyframe->position < position)
+                continue;
+
+            keyframe->state->CopyTo(this->cpu->GetState());
+            this->cpu->GetState()->SetWaitCycles(0);
+
+            while (this->position > keyframe->position) {
+                const UndoRecord &record = this->records.back();
+
+                this->writes.resize(this->writes.size() - record.writeCount);
+                this->records.pop_back();
+                this->position--;
+            }
+
+            while (this->keyframes.back().position > this->position)
+                this->PopKeyframe(false);
+
+            break;
+        }
+
+        while (this->position > position)
+            this->Undo();
+
+        return true;
+    }
+
+    void RewindBuffer::Clear()
+    {
+        while (!this->keyframes.empty())
+            this->PopKeyframe(false);
+
+        this->records.clear();
+        this->writes.clear();
+
+        this->oldestPosition = this->position;
+    }
+
+    uint64_t RewindBuffer::GetPosition() const { return this->position; }
+    uint64_t RewindBuffer::GetOldestPosition() const { return this->oldestPosition; }
+    size_t RewindBuffer::GetMemoryBudget() const { return this->memoryBudget; }
+
+    size_t RewindBuffer::GetMemoryUsage() const
+    {
+        return this->records.size() * sizeof(UndoRecord) + this->writes.size() * sizeof(MemoryUndo) + this->keyframeUsage;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+
+#include "CPUDelegate.h"
+#include "CPUState.h"
+
+namespace Emu8080
+{
+    class RewindBuffer : public CPUDelegate {
+        private:
+            // Registers as they were before an instruction executed, plus how many of the
+            // memory undo entries belong to it.
+            struct UndoRecord {
+                uint16_t pc;
+                uint16_t sp;
+                uint8_t registers[7];
+                uint8_t flags;
+                bool halt;
+                bool interuptsEnabled;
+                uint16_t writeCount;
+            };
+
+            struct MemoryUndo {
+                uint16_t addr;
+                uint8_t value;
+            };
+
+            struct Keyframe {
+                uint64_t position;
+                CPUState *state;
+            };
+
+            CPU *cpu;
+
+            size_t memoryBudget;
+            uint32_t keyframeInterval;
+
+            uint64_t position;
+            uint64_t oldestPosition;
+
+            size_t keyframeUsage;
+
+            std::deque<UndoRecord> records;
+            std::deque<MemoryUndo> writes;
+            std::deque<Keyframe> keyframes;
+
+            void PushKeyframe(const CPUState * const state);
+            void PopKeyframe(bool front);
+            void Trim();
+            void Undo();
+
+        public:
+            RewindBuffer(CPU * const cpu, size_t memoryBudget, uint32_t keyframeInterval);
+            ~RewindBuffer();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) override;
+            void WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value) override;
+
+            // Rewind
+            bool StepBack();
+            bool RewindTo(uint64_t position);
+            void Clear();
+
+            // Info
+            uint64_t GetPosition() const;
+            uint64_t GetOldestPosition() const;
+            size_t GetMemoryUsage() const;
+            size_t GetMemoryBudget() const;
+    };
+}
@@ -0,0 +1,232 @@
+#include "SequenceProfiler.h"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    static std::string SequenceName(const OpcodeSequence &sequence)
+    {
+        std::string str;
+
+        for (int i = 0; i < sequence.length; i++)
+            str += (i > 0 ? "; " : "") + Encode::DecodeMnemonic(sequence.opcodes[i]);
+
+        return str;
+    }
+
+    static bool CompareSequences(const OpcodeSequence &a, const OpcodeSequence &b) { return a.count > b.count; }
+
+    SequenceProfiler::SequenceProfiler()
+    {
+        for (int i = 0; i < 256; i++) {
+            Encode::DecodeMnemonic(i, &this->sizes[i]);
+
+            // hlt, jmp, ret, call, pchl and their undocumented aliases, plus every conditional jump/call/return and rst.
+            uint8_t group = i & 0xC7;
+            this->terminators[i] = i == 0x76 || i == 0xC3 || i == 0xCB || i == 0xC9 || i == 0xD9 || i == 0xCD || i == 0xDD
+                || i == 0xED || i == 0xFD || i == 0xE9 || group == 0xC0 || group == 0xC2 || group == 0xC4 || group == 0xC7;
+        }
+
+        this->bigrams = new uint64_t[0x10000];
+        this->Reset();
+    }
+
+    SequenceProfiler::~SequenceProfiler()
+    {
+        delete[] this->bigrams;
+    }
+
+    uint32_t SequenceProfiler::GetHooks() const { return HookRetire; }
+
+    void SequenceProfiler::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        this->instructions++;
+
+        if (this->historyLength >= 1)
+            this->bigrams[(this->history[1] << 8) | opcode]++;
+        if (this->historyLength >= 2)
+            this->trigrams[(this->history[0] << 16) | (this->history[1] << 8) | opcode]++;
+
+        this->history[0] = this->history[1];
+        this->history[1] = opcode;
+        this->historyLength = std::min(this->historyLength + 1, 2);
+
+        // Catches interrupts and anything else that moved the pc between instructions.
+        if (this->inBlock && pc != this->expectedPC)
+            this->EndBlock();
+
+        if (!this->inBlock) {
+            this->inBlock = true;
+            this->blockStart = pc;
+            this->blockInstructions = 0;
+            this->blockCycles = 0;
+        }
+
+        this->blockInstructions++;
+        this->blockCycles += cycles;
+        this->expectedPC = pc + this->sizes[opcode];
+
+        if (this->terminators[opcode])
+            this->EndBlock();
+    }
+
+    void SequenceProfiler::EndBlock()
+    {
+        auto it = this->blocks.find(this->blockStart);
+
+        if (it == this->blocks.end()) {
+            BlockProfile block;
+            block.start = this->blockStart;
+            block.entries = 0;
+            block.instructions = 0;
+            block.cycles = 0;
+            block.minLength = this->blockInstructions;
+            block.maxLength = this->blockInstructions;
+
+            it = this->blocks.insert(std::make_pair(this->blockStart, block)).first;
+        }
+
+        BlockProfile &block = it->second;
+        block.entries++;
+        block.instructions += this->blockInstructions;
+        block.cycles += this->blockCycles;
+        block.minLength = std::min(block.minLength, this->blockInstructions);
+        block.maxLength = std::max(block.maxLength, this->blockInstructions);
+
+        this->inBlock = false;
+    }
+
+    std::vector<OpcodeSequence> SequenceProfiler::GetBigrams() const
+    {
+        std::vector<OpcodeSequence> sequences;
+
+        for (uint32_t i = 0; i < 0x10000; i++) {
+            if (this->bigrams[i] == 0)
+                continue;
+
+            OpcodeSequence sequence = { { (uint8_t)(i >> 8), (uint8_t)i, 0 }, 2, this->bigrams[i] };
+            sequences.push_back(sequence);
+        }
+
+        std::sort(sequences.begin(), sequences.end(), CompareSequences);
+        return sequences;
+    }
+
+    std::vector<OpcodeSequence> SequenceProfiler::GetTrigrams() const
+    {
+        std::vector<OpcodeSequence> sequences;
+
+        for (auto &pair : this->trigrams) {
+            OpcodeSequence sequence = { { (uint8_t)(pair.first >> 16), (uint8_t)(pair.first >> 8), (uint8_t)pair.first }, 3, pair.second };
+            sequences.push_back(sequence);
+        }
+
+        std::sort(sequences.begin(), sequences.end(), CompareSequences);
+        return sequences;
+    }
+
+    // Sorted by cycles spent in the block. The block currently executing is not included until it ends.
+    std::vector<BlockProfile> SequenceProfiler::GetBlocks() const
+    {
+        std::vector<BlockProfile> blocks;
+
+        for (auto &pair : this->blocks)
+            blocks.push_back(pair.second);
+
+        std::sort(blocks.begin(), blocks.end(), [](const BlockProfile &a, const BlockProfile &b) {
+            return a.cycles != b.cycles ? a.cycles > b.cycles : a.start < b.start;
+        });
+
+        return blocks;
+    }
+
+    uint64_t SequenceProfiler::GetInstructionCount() const { return this->instructions; }
+
+    std::string SequenceProfiler::ToString(const SymbolMap * const symbols, size_t limit) const
+    {
+        double instructions = this->instructions > 0 ? this->instructions : 1;
+        std::string str;
+
+        auto bigrams = this->GetBigrams();
+        auto trigrams = this->GetTrigrams();
+        auto blocks = this->GetBlocks();
+
+        str += FormatString("%-32s %14s %7s\n", "bigram", "count", "%");
+        for (size_t i = 0; i < bigrams.size() && (limit == 0 || i < limit); i++)
+            str += FormatString("%-32s %14llu %6.2f%%\n", SequenceName(bigrams[i]).c_str(), (unsigned long long)bigrams[i].count, bigrams[i].count * 100 / instructions);
+
+        str += FormatString("\n%-32s %14s %7s\n", "trigram", "count", "%");
+        for (size_t i = 0; i < trigrams.size() && (limit == 0 || i < limit); i++)
+            str += FormatString("%-32s %14llu %6.2f%%\n", SequenceName(trigrams[i]).c_str(), (unsigned long long)trigrams[i].count, trigrams[i].count * 100 / instructions);
+
+        uint64_t totalCycles = 0;
+        for (auto &block : blocks)
+            totalCycles += block.cycles;
+
+        str += FormatString("\n%-24s %12s %10s %9s %14s %7s\n", "block", "entries", "avg len", "min/max", "cycles", "%");
+        for (size_t i = 0; i < blocks.size() && (limit == 0 || i < limit); i++) {
+            const BlockProfile &block = blocks[i];
+            std::string name = symbols != nullptr ? symbols->Describe(block.start) : FormatString("0x%04x", block.start);
+
+            str += FormatString("%-24s %12llu %10.2f %4u/%-4u %14llu %6.2f%%\n", name.c_str(), (unsigned long long)block.entries,
+                (double)block.instructions / block.entries, block.minLength, block.maxLength, (unsigned long long)block.cycles,
+                totalCycles > 0 ? block.cycles * 100.0 / totalCycles : 0);
+        }
+
+        return str;
+    }
+
+    std::string SequenceProfiler::ToJSON() const
+    {
+        std::string str = FormatString("{\"instructions\":%llu,\"bigrams\":[", (unsigned long long)this->instructions);
+
+        auto bigrams = this->GetBigrams();
+        for (size_t i = 0; i < bigrams.size(); i++)
+            str += FormatString("%s{\"opcodes\":[%u,%u],\"count\":%llu}", i > 0 ? "," : "", bigrams[i].opcodes[0], bigrams[i].opcodes[1], (unsigned long long)bigrams[i].count);
+
+        str += "],\"trigrams\":[";
+
+        auto trigrams = this->GetTrigrams();
+        for (size_t i = 0; i < trigrams.size(); i++)
+            str += FormatString("%s{\"opcodes\":[%u,%u,%u],\"count\":%llu}", i > 0 ? "," : "", trigrams[i].opcodes[0], trigrams[i].opcodes[1], trigrams[i].opcodes[2], (unsigned long long)trigrams[i].count);
+
+        str += "],\"blocks\":[";
+
+        auto blocks = this->GetBlocks();
+        for (size_t i = 0; i < blocks.size(); i++) {
+            str += FormatString("%s{\"start\":%u,\"entries\":%llu,\"instructions\":%llu,\"cycles\":%llu,\"min_length\":%u,\"max_length\":%u}", i > 0 ? "," : "",
+                blocks[i].start, (unsigned long long)blocks[i].entries, (unsigned long long)blocks[i].instructions, (unsigned long long)blocks[i].cycles,
+                blocks[i].minLength, blocks[i].maxLength);
+        }
+
+        return str + "]}";
+    }
+
+    void SequenceProfiler::WriteJSON(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "w");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        std::string str = this->ToJSON();
+        fwrite(str.data(), 1, str.size(), file);
+        fclose(file);
+    }
+
+    void SequenceProfiler::Reset()
+    {
+        std::fill(this->bigrams, this->bigrams + 0x10000, 0);
+        this->trigrams.clear();
+        this->blocks.clear();
+
+        this->instructions = 0;
+        this->historyLength = 0;
+        this->inBlock = false;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "CPUDelegate.h"
+#include "SymbolMap.h"
+
+namespace Emu8080
+{
+    struct OpcodeSequence {
+        uint8_t opcodes[3];
+        uint8_t length;
+        uint64_t count;
+    };
+
+    // Blocks are dynamic: straight-line runs ending at a control transfer or wherever execution stopped being
+    // sequential, keyed by the address they were entered at.
+    struct BlockProfile {
+        uint16_t start;
+        uint64_t entries;
+        uint64_t instructions;
+        uint64_t cycles;
+        uint32_t minLength;
+        uint32_t maxLength;
+    };
+
+    class SequenceProfiler : public CPUDelegate {
+        private:
+            uint8_t sizes[256];
+            bool terminators[256];
+
+            uint64_t *bigrams;
+            std::unordered_map<uint32_t, uint64_t> trigrams;
+            std::unordered_map<uint16_t, BlockProfile> blocks;
+
+            uint64_t instructions;
+            uint8_t history[2];
+            uint8_t historyLength;
+
+            bool inBlock;
+            uint16_t blockStart;
+            uint16_t expectedPC;
+            uint32_t blockInstructions;
+            uint64_t blockCycles;
+
+            void EndBlock();
+
+        public:
+            SequenceProfiler();
+            ~SequenceProfiler();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+
+            // Results
+            std::vector<OpcodeSequence> GetBigrams() const;
+            std::vector<OpcodeSequence> GetTrigrams() const;
+            std::vector<BlockProfile> GetBlocks() const;
+            uint64_t GetInstructionCount() const;
+            std::string ToString(const SymbolMap * const symbols = nullptr, size_t limit = 20) const;
+            std::string ToJSON() const;
+            void WriteJSON(const char * const filename) const;
+            void Reset();
+    };
+}
@@ -0,0 +1,127 @@
+#include "StateDiff.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    bool StateDiff::IsEmpty() const
+    {
+        return this->fields == 0 && this->ranges.empty();
+    }
+
+    void StateDiff::Clear()
+    {
+        this->fields = 0;
+        this->ranges.clear();
+    }
+
+    std::string StateDiff::ToString() const
+    {
+        static const char *names[] = { "pc", "sp", "a", "b", "c", "d", "e", "h", "l", "flags", "halt", "inte", "memsize" };
+
+        std::string str;
+
+        for (int i = 0; i < 13; i++) {
+            if (this->fields & (1 << i)) {
+                if (!str.empty())
+                    str += " ";
+                str += names[i];
+            }
+        }
+
+        for (auto range : this->ranges) {
+            if (!str.empty())
+                str += " ";
+
+            if (range.length == 1)
+                str += FormatString("[%04x]", range.start);
+            else
+                str += FormatString("[%04x-%04x]", range.start, range.start + range.length - 1);
+        }
+
+        return str;
+    }
+
+    // Returns a mask with bit i set if a[i] != b[i], for the 16 bytes at a and b.
+    static inline uint32_t CompareBlock16(const uint8_t * const a, const uint8_t * const b)
+    {
+#if defined(__SSE2__)
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+        return ~(uint32_t)_mm_movemask_epi8(equal) & 0xFFFF;
+#elif defined(__ARM_NEON)
+        uint8x16_t equal = vceqq_u8(vld1q_u8(a), vld1q_u8(b));
+
+        if (vminvq_u8(equal) == 0xFF)
+            return 0;
+
+        uint8_t lanes[16];
+        vst1q_u8(lanes, equal);
+
+        uint32_t mask = 0;
+        for (int i = 0; i < 16; i++)
+            mask |= (uint32_t)(lanes[i] == 0) << i;
+
+        return mask;
+#else
+        uint64_t a0, a1, b0, b1;
+        memcpy(&a0, a, 8); memcpy(&a1, a + 8, 8);
+        memcpy(&b0, b, 8); memcpy(&b1, b + 8, 8);
+
+        if (a0 == b0 && a1 == b1)
+            return 0;
+
+        uint32_t mask = 0;
+        for (int i = 0; i < 16; i++)
+            mask |= (uint32_t)(a[i] != b[i]) << i;
+
+        return mask;
+#endif
+    }
+
+    static inline void AddDifference(std::vector<MemoryRange> &ranges, size_t first, uint32_t start, uint32_t length, uint32_t mergeGap)
+    {
+        if (ranges.size() > first) {
+            MemoryRange &last = ranges.back();
+
+            if (start - (last.start + last.length) <= mergeGap) {
+                last.length = start + length - last.start;
+                return;
+            }
+        }
+
+        MemoryRange range = { start, length };
+        ranges.push_back(range);
+    }
+
+    void FindMemoryDifferences(const uint8_t * const a, const uint8_t * const b, uint32_t size, uint32_t mergeGap, std::vector<MemoryRange> &ranges)
+    {
+        size_t first = ranges.size();
+        uint32_t offset = 0;
+
+        for (; offset + 16 <= size; offset += 16) {
+            uint32_t mask = CompareBlock16(a + offset, b + offset);
+
+            // Walk runs of set bits in the mask.
+            while (mask != 0) {
+                uint32_t start = __builtin_ctz(mask);
+                uint32_t length = __builtin_ctz(~(mask >> start));
+
+                AddDifference(ranges, first, offset + start, length, mergeGap);
+                mask &= ~(((1u << length) - 1) << start);
+            }
+        }
+
+        for (; offset < size; offset++) {
+            if (a[offset] != b[offset])
+                AddDifference(ranges, first, offset, 1, mergeGap);
+        }
+    }
+}
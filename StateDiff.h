@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace Emu8080
+{
+    struct MemoryRange {
+        uint32_t start;
+        uint32_t length;
+    };
+
+    struct StateDiff {
+        enum Field : uint32_t {
+            PC = 1 << 0,
+            SP = 1 << 1,
+            A = 1 << 2,
+            B = 1 << 3,
+            C = 1 << 4,
+            D = 1 << 5,
+            E = 1 << 6,
+            H = 1 << 7,
+            L = 1 << 8,
+            Flags = 1 << 9,
+            Halt = 1 << 10,
+            InterruptsEnabled = 1 << 11,
+            MemorySize = 1 << 12
+        };
+
+        uint32_t fields;
+        std::vector<MemoryRange> ranges;
+
+        bool IsEmpty() const;
+        void Clear();
+        std::string ToString() const;
+    };
+
+    // Appends the ranges where a and b differ, merging ranges separated by at most mergeGap equal bytes.
+    void FindMemoryDifferences(const uint8_t * const a, const uint8_t * const b, uint32_t size, uint32_t mergeGap, std::vector<MemoryRange> &ranges);
+}
@@ -0,0 +1,121 @@
+#include "SymbolMap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    // One symbol per line: "<hex address> <name> [<hex size>]". Blank lines and lines starting with ';' or '#' are skipped.
+    void SymbolMap::LoadFromFile(const char * const filename)
+    {
+        FILE *file = fopen(filename, "r");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        char line[512];
+        int number = 0;
+
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            number++;
+
+            const char *start = line + strspn(line, " \t\r\n");
+
+            if (*start == '\0' || *start == ';' || *start == '#')
+                continue;
+
+            char name[256];
+            unsigned int address, size = 0;
+            int fields = sscanf(start, "%x %255s %x", &address, name, &size);
+
+            if (fields < 2 || address > 0xFFFF) {
+                fclose(file);
+                throw std::runtime_error(FormatString("Malformed symbol on line %d of '%s'.", number, filename));
+            }
+
+            this->Add(address, name, size);
+        }
+
+        fclose(file);
+    }
+
+    void SymbolMap::SaveToFile(const char * const filename) const
+    {
+        FILE *file = fopen(filename, "w");
+
+        if (file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename));
+
+        for (auto &symbol : this->symbols) {
+            if (symbol.size > 0)
+                fprintf(file, "%04x %s %x\n", symbol.address, symbol.name.c_str(), symbol.size);
+            else
+                fprintf(file, "%04x %s\n", symbol.address, symbol.name.c_str());
+        }
+
+        fclose(file);
+    }
+
+    void SymbolMap::Add(uint16_t address, const std::string &name, uint32_t size)
+    {
+        Symbol symbol;
+        symbol.address = address;
+        symbol.size = size;
+        symbol.name = name;
+
+        auto it = std::upper_bound(this->symbols.begin(), this->symbols.end(), address, [](uint16_t address, const Symbol &symbol) {
+            return address < symbol.address;
+        });
+
+        this->symbols.insert(it, symbol);
+    }
+
+    const Symbol * const SymbolMap::Lookup(uint16_t address) const
+    {
+        auto it = std::upper_bound(this->symbols.begin(), this->symbols.end(), address, [](uint16_t address, const Symbol &symbol) {
+            return address < symbol.address;
+        });
+
+        if (it == this->symbols.begin())
+            return nullptr;
+
+        const Symbol &symbol = *(it - 1);
+
+        if (symbol.size > 0 && address >= symbol.address + symbol.size)
+            return nullptr;
+
+        return &symbol;
+    }
+
+    const Symbol * const SymbolMap::Find(const std::string &name) const
+    {
+        for (auto &symbol : this->symbols) {
+            if (symbol.name == name)
+                return &symbol;
+        }
+
+        return nullptr;
+    }
+
+    std::string SymbolMap::Describe(uint16_t address) const
+    {
+        const Symbol *symbol = this->Lookup(address);
+
+        if (symbol == nullptr)
+            return FormatString("0x%04x", address);
+        if (symbol->address == address)
+            return symbol->name;
+
+        return FormatString("%s+0x%x", symbol->name.c_str(), address - symbol->address);
+    }
+
+    void SymbolMap::Clear() { this->symbols.clear(); }
+
+    size_t SymbolMap::GetCount() const { return this->symbols.size(); }
+    const std::vector<Symbol> &SymbolMap::GetSymbols() const { return this->symbols; }
+}
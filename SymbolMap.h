@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Emu8080
+{
+    struct Symbol {
+        uint16_t address;
+        uint32_t size;
+        std::string name;
+    };
+
+    // Address ranges sorted by start. A symbol without a size runs up to the next one.
+    class SymbolMap {
+        private:
+            std::vector<Symbol> symbols;
+
+        public:
+            // Load/save
+            void LoadFromFile(const char * const filename);
+            void SaveToFile(const char * const filename) const;
+
+            // Symbols
+            void Add(uint16_t address, const std::string &name, uint32_t size = 0);
+            const Symbol * const Lookup(uint16_t address) const;
+            const Symbol * const Find(const std::string &name) const;
+            std::string Describe(uint16_t address) const;
+            void Clear();
+
+            // Info
+            size_t GetCount() const;
+            const std::vector<Symbol> &GetSymbols() const;
+    };
+}
@@ -0,0 +1,64 @@
+#include "Telemetry.h"
+
+#include <string.h>
+#include <thread>
+
+namespace Emu8080
+{
+    const size_t TelemetryBlock::Words;
+
+    TelemetryBlock::TelemetryBlock()
+    {
+        this->sequence.store(0, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < Words; i++)
+            this->words[i].store(0, std::memory_order_relaxed);
+    }
+
+    void TelemetryBlock::Publish(const TelemetrySnapshot &snapshot)
+    {
+        uint64_t buffer[Words] = { 0 };
+        memcpy(buffer, &snapshot, sizeof(snapshot));
+
+        // An odd sequence marks a write in progress.
+        uint32_t sequence = this->sequence.load(std::memory_order_relaxed);
+        this->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < Words; i++)
+            this->words[i].store(buffer[i], std::memory_order_relaxed);
+
+        this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool TelemetryBlock::TryRead(TelemetrySnapshot * const snapshot) const
+    {
+        uint32_t before = this->sequence.load(std::memory_order_acquire);
+
+        if (before & 1)
+            return false;
+
+        uint64_t buffer[Words];
+
+        for (size_t i = 0; i < Words; i++)
+            buffer[i] = this->words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (this->sequence.load(std::memory_order_relaxed) != before)
+            return false;
+
+        memcpy(snapshot, buffer, sizeof(*snapshot));
+        return true;
+    }
+
+    TelemetrySnapshot TelemetryBlock::Read() const
+    {
+        TelemetrySnapshot snapshot;
+
+        while (!this->TryRead(&snapshot))
+            std::this_thread::yield();
+
+        return snapshot;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "PerformanceCounters.h"
+
+namespace Emu8080
+{
+    struct TelemetrySnapshot {
+        uint64_t publications;
+        uint16_t pc;
+        uint16_t sp;
+        bool halt;
+        PerformanceCounters counters;
+    };
+
+    // Seqlock holding the latest snapshot published by the run loop. There is one writer; any
+    // number of readers on other threads can copy out a consistent snapshot without taking a
+    // lock, retrying only if a publication lands in the middle of their read.
+    class TelemetryBlock {
+        private:
+            static const size_t Words = (sizeof(TelemetrySnapshot) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+            std::atomic<uint32_t> sequence;
+            std::atomic<uint64_t> words[Words];
+
+        public:
+            TelemetryBlock();
+
+            void Publish(const TelemetrySnapshot &snapshot);
+            bool TryRead(TelemetrySnapshot * const snapshot) const;
+            TelemetrySnapshot Read() const;
+    };
+}
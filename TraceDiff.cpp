@@ -0,0 +1,237 @@
+#include "TraceDiff.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    static const size_t ContextRecords = 8;
+
+    bool TraceDiff::IsEmpty() const
+    {
+        return this->differing == 0 && this->recordsA == this->recordsB;
+    }
+
+    void TraceDiff::Clear()
+    {
+        this->recordsA = 0;
+        this->recordsB = 0;
+        this->differing = 0;
+        this->runs.clear();
+        this->runCount = 0;
+        this->context.clear();
+        this->firstA = TraceRecord();
+        this->firstB = TraceRecord();
+        this->firstWritesA.clear();
+        this->firstWritesB.clear();
+    }
+
+    static std::string FieldsToString(uint32_t fields)
+    {
+        static const char *names[] = { "pc", "sp", "a", "b", "c", "d", "e", "h", "l", "flags", "opcode", "writes" };
+
+        std::string str;
+
+        for (int i = 0; i < 12; i++) {
+            if (fields & (1 << i)) {
+                if (!str.empty())
+                    str += " ";
+                str += names[i];
+            }
+        }
+
+        return str;
+    }
+
+    static std::string RecordToString(const char * const label, uint64_t index, const TraceRecord &record, const TraceWrite * const writes)
+    {
+        std::string mnemonic = Encode::DecodeMnemonic(record.opcode);
+        std::string str = FormatString("%-3s %12llu  %04x  %02x %-10s  %02x %02x %02x %02x %02x %02x %02x  %04x  %02x ", label, (unsigned long long)index,
+            record.pc, record.opcode, mnemonic.c_str(), record.registers[0], record.registers[1], record.registers[2], record.registers[3],
+            record.registers[4], record.registers[5], record.registers[6], record.sp, record.flags);
+
+        if (writes == nullptr) {
+            str += record.writeCount > 0 ? FormatString(" (%u writes)", record.writeCount) : "";
+        } else {
+            for (uint32_t i = 0; i < record.writeCount; i++)
+                str += FormatString(" [%04x]=%02x", writes[i].addr, writes[i].value);
+        }
+
+        return str + "\n";
+    }
+
+    static uint32_t CompareRecords(const TraceRecord &a, const TraceWrite * const writesA, const TraceRecord &b, const TraceWrite * const writesB)
+    {
+        uint32_t fields = 0;
+
+        if (a.pc != b.pc)
+            fields |= TraceDiff::PC;
+        if (a.sp != b.sp)
+            fields |= TraceDiff::SP;
+        if (a.flags != b.flags)
+            fields |= TraceDiff::Flags;
+        if (a.opcode != b.opcode)
+            fields |= TraceDiff::Opcode;
+
+        // CPUState register order is a, b, c, d, e, h, l, matching the field bits.
+        for (int i = 0; i < 7; i++) {
+            if (a.registers[i] != b.registers[i])
+                fields |= TraceDiff::A << i;
+        }
+
+        if (a.writeCount != b.writeCount) {
+            fields |= TraceDiff::Writes;
+        } else {
+            for (uint32_t i = 0; i < a.writeCount; i++) {
+                if (writesA[i].addr != writesB[i].addr || writesA[i].value != writesB[i].value) {
+                    fields |= TraceDiff::Writes;
+                    break;
+                }
+            }
+        }
+
+        return fields;
+    }
+
+    std::string TraceDiff::ToString() const
+    {
+        uint64_t compared = std::min(this->recordsA, this->recordsB);
+
+        if (this->IsEmpty())
+            return FormatString("Traces are identical (%llu records).\n", (unsigned long long)compared);
+
+        std::string str = FormatString("%llu of %llu compared records differ, in %llu runs (a: %llu records, b: %llu records).\n",
+            (unsigned long long)this->differing, (unsigned long long)compared, (unsigned long long)this->runCount,
+            (unsigned long long)this->recordsA, (unsigned long long)this->recordsB);
+
+        if (this->differing == 0)
+            return str + FormatString("The traces match until the shorter one ends at record %llu.\n", (unsigned long long)compared);
+
+        uint64_t first = this->runs[0].start;
+        uint32_t fields = CompareRecords(this->firstA, this->firstWritesA.data(), this->firstB, this->firstWritesB.data());
+
+        str += FormatString("\nFirst divergence at record %llu: %s\n", (unsigned long long)first, FieldsToString(fields).c_str());
+        str += FormatString("%-3s %12s  %-4s  %-13s  %-2s %-2s %-2s %-2s %-2s %-2s %-2s  %-4s  %-2s  %s\n", "", "record", "pc", "op", "a", "b", "c", "d", "e", "h", "l", "sp", "fl", "writes");
+
+        for (size_t i = 0; i < this->context.size(); i++)
+            str += RecordToString("", first - this->context.size() + i, this->context[i], nullptr);
+
+        str += RecordToString("a:", first, this->firstA, this->firstWritesA.data());
+        str += RecordToString("b:", first, this->firstB, this->firstWritesB.data());
+
+        str += "\nDivergent runs:\n";
+
+        for (auto &run : this->runs)
+            str += FormatString("  %12llu-%-12llu %12llu records  %s\n", (unsigned long long)run.start, (unsigned long long)(run.start + run.length - 1),
+                (unsigned long long)run.length, FieldsToString(run.fields).c_str());
+
+        if (this->runCount > this->runs.size())
+            str += FormatString("  ... %llu more\n", (unsigned long long)(this->runCount - this->runs.size()));
+
+        return str;
+    }
+
+    void DiffTraces(const TraceReader * const a, const TraceReader * const b, TraceDiff * const diff, unsigned threads, size_t maxRuns)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // The first run is where the report starts, so it is always kept.
+        maxRuns = std::max<size_t>(maxRuns, 1);
+
+        diff->Clear();
+        diff->recordsA = a->GetRecordCount();
+        diff->recordsB = b->GetRecordCount();
+
+        TraceBlockStream streamA(a, std::max(1u, threads / 2));
+        TraceBlockStream streamB(b, std::max(1u, threads - threads / 2));
+
+        const TraceBlock *blockA = streamA.Next();
+        const TraceBlock *blockB = streamB.Next();
+        size_t positionA = 0, positionB = 0;
+
+        uint64_t index = 0;
+        uint64_t lastDiffering = UINT64_MAX;
+        TraceDivergence run = TraceDivergence();
+
+        // The last records of earlier A blocks, so a divergence at the start of a block still gets context.
+        std::vector<TraceRecord> previous;
+
+        while (blockA != nullptr && blockB != nullptr) {
+            if (positionA == blockA->records.size()) {
+                if (diff->differing == 0) {
+                    size_t keep = std::min(blockA->records.size(), ContextRecords);
+                    previous.insert(previous.end(), blockA->records.end() - keep, blockA->records.end());
+
+                    if (previous.size() > ContextRecords)
+                        previous.erase(previous.begin(), previous.end() - ContextRecords);
+                }
+
+                blockA = streamA.Next();
+                positionA = 0;
+                continue;
+            }
+
+            if (positionB == blockB->records.size()) {
+                blockB = streamB.Next();
+                positionB = 0;
+                continue;
+            }
+
+            size_t count = std::min(blockA->records.size() - positionA, blockB->records.size() - positionB);
+            const TraceRecord *recordsA = blockA->records.data() + positionA;
+            const TraceRecord *recordsB = blockB->records.data() + positionB;
+
+            for (size_t i = 0; i < count; i++, index++) {
+                const TraceRecord &recordA = recordsA[i], &recordB = recordsB[i];
+                const TraceWrite *writesA = blockA->writes.data() + recordA.firstWrite;
+                const TraceWrite *writesB = blockB->writes.data() + recordB.firstWrite;
+
+                // Almost every record matches, so rule that out with a memcmp before looking at fields.
+                if (memcmp(&recordA, &recordB, TraceRecordCompareSize) == 0 && recordA.writeCount == 0 && recordB.writeCount == 0)
+                    continue;
+
+                uint32_t fields = CompareRecords(recordA, writesA, recordB, writesB);
+
+                if (fields == 0)
+                    continue;
+
+                if (diff->differing++ == 0) {
+                    size_t inBlock = std::min(positionA + i, ContextRecords);
+                    size_t carried = std::min(previous.size(), ContextRecords - inBlock);
+
+                    diff->context.assign(previous.end() - carried, previous.end());
+                    diff->context.insert(diff->context.end(), blockA->records.begin() + positionA + i - inBlock, blockA->records.begin() + positionA + i);
+                    diff->firstA = recordA;
+                    diff->firstB = recordB;
+                    diff->firstWritesA.assign(writesA, writesA + recordA.writeCount);
+                    diff->firstWritesB.assign(writesB, writesB + recordB.writeCount);
+                }
+
+                if (lastDiffering != UINT64_MAX && lastDiffering + 1 == index) {
+                    run.length++;
+                    run.fields |= fields;
+                } else {
+                    if (lastDiffering != UINT64_MAX && diff->runs.size() < maxRuns)
+                        diff->runs.push_back(run);
+
+                    diff->runCount++;
+                    run.start = index;
+                    run.length = 1;
+                    run.fields = fields;
+                }
+
+                lastDiffering = index;
+            }
+
+            positionA += count;
+            positionB += count;
+        }
+
+        if (lastDiffering != UINT64_MAX && diff->runs.size() < maxRuns)
+            diff->runs.push_back(run);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "TraceReader.h"
+
+namespace Emu8080
+{
+    // A run of consecutive records that differ, with every field that differed anywhere in it.
+    struct TraceDivergence {
+        uint64_t start;
+        uint64_t length;
+        uint32_t fields;
+    };
+
+    struct TraceDiff {
+        enum Field : uint32_t {
+            PC = 1 << 0,
+            SP = 1 << 1,
+            A = 1 << 2,
+            B = 1 << 3,
+            C = 1 << 4,
+            D = 1 << 5,
+            E = 1 << 6,
+            H = 1 << 7,
+            L = 1 << 8,
+            Flags = 1 << 9,
+            Opcode = 1 << 10,
+            Writes = 1 << 11
+        };
+
+        uint64_t recordsA;
+        uint64_t recordsB;
+        uint64_t differing;
+
+        // Only the first few runs are kept; runCount is the total.
+        std::vector<TraceDivergence> runs;
+        uint64_t runCount;
+
+        // The first differing pair, and the records just before it, which are the same in both traces.
+        std::vector<TraceRecord> context;
+        TraceRecord firstA;
+        TraceRecord firstB;
+        std::vector<TraceWrite> firstWritesA;
+        std::vector<TraceWrite> firstWritesB;
+
+        bool IsEmpty() const;
+        void Clear();
+        std::string ToString() const;
+    };
+
+    // Streams both traces through TraceBlockStreams, comparing record by record, so memory use stays at
+    // a few blocks per trace. threads is split between the two streams.
+    void DiffTraces(const TraceReader * const a, const TraceReader * const b, TraceDiff * const diff, unsigned threads = 0, size_t maxRuns = 16);
+}
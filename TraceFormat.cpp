@@ -0,0 +1,159 @@
+#include "TraceFormat.h"
+
+#include <string.h>
+
+namespace Emu8080
+{
+    // A sequence is a token (literal length in the high nibble, match length - 4 in the low; 15 continues in
+    // bytes of up to 255), the literals, then a two-byte offset and the match. The last sequence has no match.
+    static const size_t MinMatch = 4;
+    static const size_t MaxOffset = 0xFFFF;
+
+    static uint8_t *WriteLength(uint8_t *out, size_t length)
+    {
+        for (; length >= 0xFF; length -= 0xFF)
+            *out++ = 0xFF;
+
+        *out++ = length;
+        return out;
+    }
+
+    static uint8_t *EmitSequence(uint8_t *out, const uint8_t * const limit, const uint8_t * const literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        size_t worst = 1 + literalLength / 0xFF + 1 + literalLength + 2 + matchLength / 0xFF + 1;
+
+        if (out + worst >= limit)
+            return nullptr;
+
+        size_t matchCode = matchLength > 0 ? matchLength - MinMatch : 0;
+        *out++ = (literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15);
+
+        if (literalLength >= 15)
+            out = WriteLength(out, literalLength - 15);
+
+        memcpy(out, literals, literalLength);
+        out += literalLength;
+
+        if (matchLength == 0)
+            return out;
+
+        *out++ = offset & 0xFF;
+        *out++ = offset >> 8;
+
+        if (matchCode >= 15)
+            out = WriteLength(out, matchCode - 15);
+
+        return out;
+    }
+
+    size_t CompressTraceBlock(const uint8_t * const src, size_t size, uint8_t * const dst, uint32_t * const table)
+    {
+        memset(table, 0, TraceCompressTableSize * sizeof(uint32_t));
+
+        const uint8_t *ip = src, *anchor = src, *end = src + size;
+        uint8_t *out = dst;
+        const uint8_t *limit = dst + size;
+
+        while (size >= MinMatch && ip <= end - MinMatch) {
+            uint32_t value, candidate;
+            memcpy(&value, ip, sizeof(value));
+
+            uint32_t hash = (value * 2654435761u) >> (32 - 14);
+            const uint8_t *ref = src + table[hash];
+            table[hash] = (uint32_t)(ip - src);
+
+            memcpy(&candidate, ref, sizeof(candidate));
+
+            if (ref >= ip || (size_t)(ip - ref) > MaxOffset || candidate != value) {
+                ip++;
+                continue;
+            }
+
+            const uint8_t *matchEnd = ip + MinMatch, *refEnd = ref + MinMatch;
+
+            while (matchEnd < end && *matchEnd == *refEnd) {
+                matchEnd++;
+                refEnd++;
+            }
+
+            out = EmitSequence(out, limit, anchor, ip - anchor, ip - ref, matchEnd - ip);
+
+            if (out == nullptr)
+                return 0;
+
+            ip = anchor = matchEnd;
+        }
+
+        out = EmitSequence(out, limit, anchor, end - anchor, 0, 0);
+
+        return out != nullptr ? out - dst : 0;
+    }
+
+    static bool ReadLength(const uint8_t *&in, const uint8_t * const end, size_t &length)
+    {
+        uint8_t byte;
+
+        do {
+            if (in >= end)
+                return false;
+
+            byte = *in++;
+            length += byte;
+        } while (byte == 0xFF);
+
+        return true;
+    }
+
+    bool DecompressTraceBlock(const uint8_t * const src, size_t size, uint8_t * const dst, size_t rawSize)
+    {
+        const uint8_t *in = src, *end = src + size;
+        uint8_t *out = dst, *outEnd = dst + rawSize;
+
+        while (in < end) {
+            uint8_t token = *in++;
+            size_t length = token >> 4;
+
+            if (length == 15 && !ReadLength(in, end, length))
+                return false;
+
+            if (length > (size_t)(end - in) || length > (size_t)(outEnd - out))
+                return false;
+
+            memcpy(out, in, length);
+            out += length;
+            in += length;
+
+            if (in == end)
+                return out == outEnd;
+
+            if (end - in < 2)
+                return false;
+
+            size_t offset = in[0] | in[1] << 8;
+            in += 2;
+
+            length = token & 0x0F;
+
+            if (length == 15 && !ReadLength(in, end, length))
+                return false;
+
+            length += MinMatch;
+
+            if (offset == 0 || offset > (size_t)(out - dst) || length > (size_t)(outEnd - out))
+                return false;
+
+            const uint8_t *ref = out - offset;
+
+            // Overlapping matches repeat the last offset bytes, so they have to be copied forwards a byte at a time.
+            if (offset >= length) {
+                memcpy(out, ref, length);
+                out += length;
+            } else {
+                for (size_t i = 0; i < length; i++)
+                    *out++ = ref[i];
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Emu8080
+{
+    // Binary execution traces: a TraceFileHeader, then blocks of delta-encoded records. Each block starts
+    // from the TraceState in its header, so blocks decode independently of each other.
+    //
+    // A record is a tag byte, the opcode, then the fields the tag calls for, in this order:
+    //   TraceTagPC         pc differs from the previous record's fall-through address; zigzag varint delta follows
+    //   TraceTagRegisters  a mask of changed registers follows (bit i is registers[i], bit 7 is flags), then each new value
+    //   TraceTagSP         sp changed; zigzag varint delta follows
+    //   TraceTagWrites     the write count follows as a varint; otherwise it is the low two bits of the tag
+    // and finally each memory write as a zigzag varint delta from the previous write address plus the value.
+    // Registers and sp are as they were after the instruction. Writes made between instructions, such as
+    // an interrupt's push, belong to the following record.
+    static const char TraceFileMagic[4] = { 'E', '8', '0', 'T' };
+    static const char TraceBlockMagic[4] = { 'E', '8', '0', 'B' };
+    static const uint32_t TraceVersion = 1;
+
+    static const uint8_t TraceTagWriteCount = 0x03;
+    static const uint8_t TraceTagPC = 0x04;
+    static const uint8_t TraceTagRegisters = 0x08;
+    static const uint8_t TraceTagSP = 0x10;
+    static const uint8_t TraceTagWrites = 0x20;
+
+    // Largest record without its writes: tag, opcode, pc, register mask and values, sp, write count.
+    static const size_t TraceMaxRecordSize = 1 + 1 + 3 + 1 + 8 + 3 + 5;
+    static const size_t TraceMaxWriteSize = 3 + 1;
+
+    struct TraceFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t blockSize;
+        uint32_t reserved;
+    };
+
+    // pc is the fall-through address the next record is compared against; registers are in CPUState order.
+    struct TraceState {
+        uint16_t pc;
+        uint16_t sp;
+        uint16_t writeAddress;
+        uint8_t registers[7];
+        uint8_t flags;
+        uint8_t reserved[2];
+    };
+
+    // The payload is compressed when storedSize is less than rawSize.
+    struct TraceBlockHeader {
+        char magic[4];
+        uint32_t storedSize;
+        uint32_t rawSize;
+        uint32_t records;
+        uint64_t firstRecord;
+        TraceState start;
+    };
+
+    inline uint8_t *TraceWriteVarint(uint8_t *out, uint32_t value)
+    {
+        while (value >= 0x80) {
+            *out++ = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+
+        *out++ = value;
+        return out;
+    }
+
+    // Deltas are taken modulo 64K, so any 16-bit step fits in three varint bytes.
+    inline uint32_t TraceZigZag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+    inline int32_t TraceUnZigZag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+    // LZ77 block codec for trace payloads. Compress returns the compressed size, or 0 if the result would
+    // not be smaller than the input; dst needs size bytes and table TraceCompressTableSize entries.
+    // Decompress returns false on malformed input.
+    static const size_t TraceCompressTableSize = 1 << 14;
+
+    size_t CompressTraceBlock(const uint8_t * const src, size_t size, uint8_t * const dst, uint32_t * const table);
+    bool DecompressTraceBlock(const uint8_t * const src, size_t size, uint8_t * const dst, size_t rawSize);
+}
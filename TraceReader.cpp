@@ -0,0 +1,271 @@
+#include "TraceReader.h"
+
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    TraceReader::TraceReader(const std::string &filename)
+    {
+        this->filename = filename;
+
+        for (int i = 0; i < 256; i++)
+            Encode::DecodeMnemonic(i, &this->sizes[i]);
+
+        int fd = open(filename.c_str(), O_RDONLY);
+
+        if (fd < 0)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename.c_str()));
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceFileHeader)) {
+            close(fd);
+            throw std::runtime_error(FormatString("'%s' is not a valid trace.", filename.c_str()));
+        }
+
+        this->mappingSize = st.st_size;
+        void *mapping = mmap(nullptr, this->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(FormatString("Failed to map trace '%s'.", filename.c_str()));
+
+        this->mapping = (const uint8_t *)mapping;
+        madvise(mapping, this->mappingSize, MADV_SEQUENTIAL);
+
+        const TraceFileHeader *header = (const TraceFileHeader *)this->mapping;
+
+        if (memcmp(header->magic, TraceFileMagic, sizeof(TraceFileMagic)) != 0 || header->version != TraceVersion) {
+            munmap(mapping, this->mappingSize);
+            throw std::runtime_error(FormatString("'%s' is not a valid trace.", filename.c_str()));
+        }
+
+        // Index the blocks by hopping from header to header; payloads are not touched.
+        size_t offset = sizeof(TraceFileHeader);
+        this->recordCount = 0;
+
+        while (offset < this->mappingSize) {
+            // A writer that was killed mid-block leaves a partial block at the end; everything before it is usable.
+            if (this->mappingSize - offset < sizeof(TraceBlockHeader))
+                break;
+
+            // Blocks are packed, so headers are unaligned and have to be copied out.
+            TraceBlockHeader block;
+            memcpy(&block, this->mapping + offset, sizeof(block));
+
+            if (block.storedSize > this->mappingSize - offset - sizeof(TraceBlockHeader))
+                break;
+
+            if (memcmp(block.magic, TraceBlockMagic, sizeof(TraceBlockMagic)) != 0 || block.storedSize > block.rawSize
+             || block.firstRecord != this->recordCount) {
+                munmap(mapping, this->mappingSize);
+                throw std::runtime_error(FormatString("Trace '%s' has a corrupt block at offset 0x%zx.", filename.c_str(), offset));
+            }
+
+            this->offsets.push_back(offset);
+            this->recordCount += block.records;
+
+            offset += sizeof(TraceBlockHeader) + block.storedSize;
+        }
+    }
+
+    TraceReader::~TraceReader()
+    {
+        munmap((void *)this->mapping, this->mappingSize);
+    }
+
+    const std::string &TraceReader::GetFilename() const { return this->filename; }
+    size_t TraceReader::GetBlockCount() const { return this->offsets.size(); }
+    uint64_t TraceReader::GetRecordCount() const { return this->recordCount; }
+
+    TraceBlockHeader TraceReader::GetBlockHeader(size_t index) const
+    {
+        TraceBlockHeader header;
+        memcpy(&header, this->mapping + this->offsets[index], sizeof(header));
+
+        return header;
+    }
+
+    static uint32_t ReadVarint(const uint8_t *&in, const uint8_t * const end)
+    {
+        uint32_t value = 0;
+
+        for (int shift = 0; shift < 35 && in < end; shift += 7) {
+            uint8_t byte = *in++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        throw std::runtime_error("Trace block contains a malformed varint.");
+    }
+
+    void TraceReader::DecodeBlock(size_t index, TraceBlock * const block) const
+    {
+        TraceBlockHeader header = this->GetBlockHeader(index);
+        const uint8_t *payload = this->mapping + this->offsets[index] + sizeof(TraceBlockHeader);
+        const uint8_t *in = payload, *end = payload + header.storedSize;
+
+        if (header.storedSize < header.rawSize) {
+            block->raw.resize(header.rawSize);
+
+            if (!DecompressTraceBlock(payload, header.storedSize, block->raw.data(), header.rawSize))
+                throw std::runtime_error(FormatString("Trace '%s' has a corrupt block at record %llu.", this->filename.c_str(), (unsigned long long)header.firstRecord));
+
+            in = block->raw.data();
+            end = in + header.rawSize;
+        }
+
+        block->firstRecord = header.firstRecord;
+        block->records.resize(header.records);
+        block->writes.clear();
+
+        TraceState state = header.start;
+        TraceRecord *record = block->records.data();
+
+        for (uint32_t i = 0; i < header.records; i++, record++) {
+            if (end - in < 2)
+                throw std::runtime_error(FormatString("Trace '%s' has a truncated block at record %llu.", this->filename.c_str(), (unsigned long long)header.firstRecord));
+
+            uint8_t tag = *in++;
+            record->opcode = *in++;
+            record->pc = state.pc;
+
+            if (tag & TraceTagPC)
+                record->pc += TraceUnZigZag(ReadVarint(in, end));
+
+            if (tag & TraceTagRegisters) {
+                uint8_t mask = in < end ? *in++ : 0;
+
+                for (int r = 0; r < 7; r++) {
+                    if ((mask & (1 << r)) && in < end)
+                        state.registers[r] = *in++;
+                }
+
+                if ((mask & 0x80) && in < end)
+                    state.flags = *in++;
+            }
+
+            if (tag & TraceTagSP)
+                state.sp += TraceUnZigZag(ReadVarint(in, end));
+
+            uint32_t writes = (tag & TraceTagWrites) ? ReadVarint(in, end) : tag & TraceTagWriteCount;
+
+            record->sp = state.sp;
+            record->flags = state.flags;
+            memcpy(record->registers, state.registers, sizeof(record->registers));
+            record->writeCount = writes;
+            record->firstWrite = block->writes.size();
+
+            for (uint32_t w = 0; w < writes; w++) {
+                state.writeAddress += TraceUnZigZag(ReadVarint(in, end));
+
+                if (in >= end)
+                    throw std::runtime_error(FormatString("Trace '%s' has a truncated block at record %llu.", this->filename.c_str(), (unsigned long long)header.firstRecord));
+
+                TraceWrite write = { state.writeAddress, *in++ };
+                block->writes.push_back(write);
+            }
+
+            state.pc = record->pc + this->sizes[record->opcode];
+        }
+    }
+
+    TraceBlockStream::TraceBlockStream(const TraceReader * const reader, unsigned threads)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        this->reader = reader;
+        this->slots.resize(threads * 2);
+        this->ready.resize(threads * 2, UINT64_MAX);
+        this->errors.resize(threads * 2);
+        this->next = 0;
+        this->consumed = 0;
+        this->outstanding = false;
+        this->stop = false;
+
+        for (unsigned i = 0; i < threads; i++)
+            this->workers.push_back(std::thread(&TraceBlockStream::WorkerLoop, this));
+    }
+
+    TraceBlockStream::~TraceBlockStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stop = true;
+        }
+
+        this->condition.notify_all();
+
+        for (auto &worker : this->workers)
+            worker.join();
+    }
+
+    // Block i decodes into slot i % window, once the consumer has moved past the block that held it before.
+    void TraceBlockStream::WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        size_t window = this->slots.size();
+
+        while (!this->stop && this->next < this->reader->GetBlockCount()) {
+            size_t index = this->next++;
+
+            this->condition.wait(lock, [&] { return this->stop || index < this->consumed + window; });
+
+            if (this->stop)
+                return;
+
+            lock.unlock();
+
+            std::exception_ptr error;
+
+            try {
+                this->reader->DecodeBlock(index, &this->slots[index % window]);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+
+            this->errors[index % window] = error;
+            this->ready[index % window] = index;
+            this->condition.notify_all();
+        }
+    }
+
+    const TraceBlock *TraceBlockStream::Next()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        size_t window = this->slots.size();
+
+        // The previously returned block's slot can now be reused.
+        if (this->outstanding) {
+            this->consumed++;
+            this->outstanding = false;
+            this->condition.notify_all();
+        }
+
+        if (this->consumed >= this->reader->GetBlockCount())
+            return nullptr;
+
+        size_t index = this->consumed;
+        this->condition.wait(lock, [&] { return this->ready[index % window] == index; });
+
+        if (this->errors[index % window])
+            std::rethrow_exception(this->errors[index % window]);
+
+        this->outstanding = true;
+        return &this->slots[index % window];
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "TraceFormat.h"
+
+namespace Emu8080
+{
+    struct TraceWrite {
+        uint16_t addr;
+        uint8_t value;
+    };
+
+    // One decoded record: state after the instruction at pc, and its writes in the owning block's writes.
+    // pc through registers are packed so two records compare with one memcmp of TraceRecordCompareSize bytes.
+    struct TraceRecord {
+        uint16_t pc;
+        uint16_t sp;
+        uint8_t opcode;
+        uint8_t flags;
+        uint8_t registers[7];
+        uint32_t writeCount;
+        uint32_t firstWrite;
+    };
+
+    static const size_t TraceRecordCompareSize = offsetof(TraceRecord, registers) + 7;
+
+    struct TraceBlock {
+        uint64_t firstRecord;
+        std::vector<TraceRecord> records;
+        std::vector<TraceWrite> writes;
+
+        // Decompression scratch, kept so a reused block decodes without allocating.
+        std::vector<uint8_t> raw;
+    };
+
+    // Read-only view of a trace written by TraceWriter. The file is memory mapped and only block headers
+    // are read up front; blocks decode independently, so DecodeBlock can be called from any thread.
+    class TraceReader {
+        private:
+            std::string filename;
+            const uint8_t *mapping;
+            size_t mappingSize;
+
+            std::vector<size_t> offsets;
+            uint64_t recordCount;
+            uint8_t sizes[256];
+
+        public:
+            TraceReader(const std::string &filename);
+            ~TraceReader();
+
+            const std::string &GetFilename() const;
+            size_t GetBlockCount() const;
+            uint64_t GetRecordCount() const;
+            TraceBlockHeader GetBlockHeader(size_t index) const;
+
+            void DecodeBlock(size_t index, TraceBlock * const block) const;
+    };
+
+    // Hands out a reader's blocks in order while worker threads decode the ones ahead. At most
+    // window blocks are held in memory at once, however long the trace.
+    class TraceBlockStream {
+        private:
+            const TraceReader *reader;
+
+            std::vector<TraceBlock> slots;
+            std::vector<uint64_t> ready;
+            std::vector<std::exception_ptr> errors;
+            size_t next;
+            size_t consumed;
+            bool outstanding;
+            bool stop;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::vector<std::thread> workers;
+
+            void WorkerLoop();
+
+        public:
+            TraceBlockStream(const TraceReader * const reader, unsigned threads = 0);
+            ~TraceBlockStream();
+
+            // The returned block stays valid until the following call; nullptr at the end of the trace.
+            const TraceBlock *Next();
+    };
+}
@@ -0,0 +1,294 @@
+#include "TraceWriter.h"
+
+#include <string.h>
+#include <chrono>
+#include <stdexcept>
+
+#include "CPU.h"
+#include "Encode.h"
+#include "Util.h"
+
+namespace Emu8080
+{
+    TraceWriter::TraceWriter(const std::string &filename, uint32_t blockSize, uint32_t buffers)
+    {
+        this->filename = filename;
+        this->blockSize = blockSize >= 0x1000 ? blockSize : 0x1000;
+
+        this->file = fopen(filename.c_str(), "wb");
+
+        if (this->file == nullptr)
+            throw std::runtime_error(FormatString("Failed to open file '%s'.", filename.c_str()));
+
+        TraceFileHeader header = TraceFileHeader();
+        memcpy(header.magic, TraceFileMagic, sizeof(TraceFileMagic));
+        header.version = TraceVersion;
+        header.blockSize = this->blockSize;
+
+        if (fwrite(&header, sizeof(header), 1, this->file) != 1) {
+            fclose(this->file);
+            throw std::runtime_error(FormatString("Failed to write trace '%s'.", filename.c_str()));
+        }
+
+        for (uint32_t i = 0; i < (buffers >= 2 ? buffers : 2); i++) {
+            Block *block = new Block();
+            block->capacity = this->blockSize;
+            block->data = new uint8_t[block->capacity];
+
+            this->blocks.push_back(block);
+            this->freeBlocks.push_back(block);
+        }
+
+        for (int i = 0; i < 256; i++)
+            Encode::DecodeMnemonic(i, &this->sizes[i]);
+
+        this->state = TraceState();
+        this->records = 0;
+
+        this->table.resize(TraceCompressTableSize);
+
+        this->stats = TraceStats();
+        this->busy = false;
+        this->failed = false;
+        this->stop = false;
+
+        this->current = nullptr;
+        this->StartBlock();
+
+        this->worker = std::thread(&TraceWriter::WorkerLoop, this);
+    }
+
+    TraceWriter::~TraceWriter()
+    {
+        this->Finish();
+
+        for (auto block : this->blocks) {
+            delete[] block->data;
+            delete block;
+        }
+    }
+
+    uint32_t TraceWriter::GetHooks() const { return HookRetire | HookWrite; }
+
+    void TraceWriter::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        size_t needed = TraceMaxRecordSize + this->writes.size() * TraceMaxWriteSize;
+
+        if (this->current->size + needed > this->current->capacity && this->current->header.records > 0) {
+            this->SubmitBlock();
+            this->StartBlock();
+        }
+
+        // Only a host write of a large range between instructions can outgrow an empty block.
+        if (needed > this->current->capacity) {
+            delete[] this->current->data;
+            this->current->capacity = needed;
+            this->current->data = new uint8_t[needed];
+        }
+
+        const CPUState *cpuState = cpu->GetState();
+        TraceState &state = this->state;
+
+        uint8_t *record = this->current->data + this->current->size;
+        uint8_t *out = record + 2;
+        uint8_t tag = 0;
+
+        record[1] = opcode;
+
+        if (pc != state.pc) {
+            tag |= TraceTagPC;
+            out = TraceWriteVarint(out, TraceZigZag((int16_t)(pc - state.pc)));
+        }
+
+        const uint8_t *registers = cpuState->GetRegisters();
+        uint8_t flags = cpuState->GetFlags();
+        uint8_t *mask = out++;
+
+        *mask = 0;
+
+        for (int i = 0; i < 7; i++) {
+            if (registers[i] != state.registers[i]) {
+                *mask |= 1 << i;
+                *out++ = state.registers[i] = registers[i];
+            }
+        }
+
+        if (flags != state.flags) {
+            *mask |= 0x80;
+            *out++ = state.flags = flags;
+        }
+
+        if (*mask != 0)
+            tag |= TraceTagRegisters;
+        else
+            out--;
+
+        uint16_t sp = cpuState->GetSP();
+
+        if (sp != state.sp) {
+            tag |= TraceTagSP;
+            out = TraceWriteVarint(out, TraceZigZag((int16_t)(sp - state.sp)));
+            state.sp = sp;
+        }
+
+        if (this->writes.size() > TraceTagWriteCount) {
+            tag |= TraceTagWrites;
+            out = TraceWriteVarint(out, (uint32_t)this->writes.size());
+        } else {
+            tag |= this->writes.size();
+        }
+
+        for (auto write : this->writes) {
+            uint16_t addr = write >> 8;
+
+            out = TraceWriteVarint(out, TraceZigZag((int16_t)(addr - state.writeAddress)));
+            *out++ = write & 0xFF;
+            state.writeAddress = addr;
+        }
+
+        record[0] = tag;
+
+        this->current->size = out - this->current->data;
+        this->current->header.records++;
+        this->records++;
+
+        state.pc = pc + this->sizes[opcode];
+        this->writes.clear();
+    }
+
+    void TraceWriter::WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        this->writes.push_back((uint32_t)addr << 8 | value);
+    }
+
+    void TraceWriter::StartBlock()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        if (this->freeBlocks.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            this->condition.wait(lock, [this] { return !this->freeBlocks.empty(); });
+
+            this->stats.stalls++;
+            this->stats.stallNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        this->current = this->freeBlocks.front();
+        this->freeBlocks.pop_front();
+
+        TraceBlockHeader &header = this->current->header;
+        header = TraceBlockHeader();
+        memcpy(header.magic, TraceBlockMagic, sizeof(TraceBlockMagic));
+        header.firstRecord = this->records;
+        header.start = this->state;
+
+        this->current->size = 0;
+    }
+
+    void TraceWriter::SubmitBlock()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            if (this->failed)
+                throw std::runtime_error(FormatString("Failed to write trace '%s'.", this->filename.c_str()));
+
+            this->fullBlocks.push_back(this->current);
+            this->current = nullptr;
+        }
+
+        this->condition.notify_all();
+    }
+
+    void TraceWriter::Flush()
+    {
+        if (this->current->header.records > 0) {
+            this->SubmitBlock();
+            this->StartBlock();
+        }
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->condition.wait(lock, [this] { return this->fullBlocks.empty() && !this->busy; });
+
+        if (this->failed || fflush(this->file) != 0)
+            throw std::runtime_error(FormatString("Failed to write trace '%s'.", this->filename.c_str()));
+    }
+
+    // Like Flush, but never throws; used on destruction.
+    void TraceWriter::Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            if (this->current->header.records > 0) {
+                this->fullBlocks.push_back(this->current);
+                this->current = nullptr;
+            }
+
+            this->stop = true;
+        }
+
+        this->condition.notify_all();
+        this->worker.join();
+
+        fclose(this->file);
+    }
+
+    void TraceWriter::WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        while (true) {
+            this->condition.wait(lock, [this] { return !this->fullBlocks.empty() || this->stop; });
+
+            if (this->fullBlocks.empty())
+                return;
+
+            Block *block = this->fullBlocks.front();
+            this->fullBlocks.pop_front();
+            this->busy = true;
+
+            // A block is owned by the worker until it is back on the free list, so it can be written unlocked.
+            bool skip = this->failed;
+            lock.unlock();
+            bool ok = !skip && this->WriteBlock(block);
+            lock.lock();
+
+            if (ok) {
+                this->stats.records += block->header.records;
+                this->stats.blocks++;
+                this->stats.rawBytes += block->header.rawSize;
+                this->stats.storedBytes += sizeof(TraceBlockHeader) + block->header.storedSize;
+            } else {
+                this->failed = true;
+            }
+
+            this->busy = false;
+            this->freeBlocks.push_back(block);
+            this->condition.notify_all();
+        }
+    }
+
+    bool TraceWriter::WriteBlock(Block * const block)
+    {
+        if (this->packed.size() < block->size)
+            this->packed.resize(block->size);
+
+        size_t packedSize = CompressTraceBlock(block->data, block->size, this->packed.data(), this->table.data());
+        const uint8_t *payload = packedSize > 0 ? this->packed.data() : block->data;
+
+        block->header.rawSize = block->size;
+        block->header.storedSize = packedSize > 0 ? packedSize : block->size;
+
+        return fwrite(&block->header, sizeof(block->header), 1, this->file) == 1 &&
+            fwrite(payload, 1, block->header.storedSize, this->file) == block->header.storedSize;
+    }
+
+    TraceStats TraceWriter::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->stats;
+    }
+
+    const std::string &TraceWriter::GetFilename() const { return this->filename; }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "CPUDelegate.h"
+#include "TraceFormat.h"
+
+namespace Emu8080
+{
+    struct TraceStats {
+        uint64_t records;
+        uint64_t blocks;
+        uint64_t rawBytes;
+        uint64_t storedBytes;
+
+        // Times the CPU had to wait for the writer because every buffer was still in flight.
+        uint64_t stalls;
+        uint64_t stallNanoseconds;
+    };
+
+    // Streams a binary execution trace (see TraceFormat.h). Records are delta-encoded into the current
+    // block on the CPU thread; full blocks go to a worker thread that compresses and writes them, while
+    // the CPU fills the next buffer.
+    class TraceWriter : public CPUDelegate {
+        private:
+            struct Block {
+                TraceBlockHeader header;
+                uint8_t *data;
+                uint32_t size;
+                uint32_t capacity;
+            };
+
+            std::string filename;
+            FILE *file;
+            uint32_t blockSize;
+
+            std::vector<Block *> blocks;
+            std::deque<Block *> freeBlocks;
+            std::deque<Block *> fullBlocks;
+            Block *current;
+
+            TraceState state;
+            uint8_t sizes[256];
+            std::vector<uint32_t> writes;
+            uint64_t records;
+
+            std::vector<uint8_t> packed;
+            std::vector<uint32_t> table;
+
+            TraceStats stats;
+            bool busy;
+            bool failed;
+            bool stop;
+
+            mutable std::mutex mutex;
+            std::condition_variable condition;
+            std::thread worker;
+
+            void StartBlock();
+            void SubmitBlock();
+            void WorkerLoop();
+            bool WriteBlock(Block * const block);
+            void Finish();
+
+        public:
+            TraceWriter(const std::string &filename, uint32_t blockSize = 0x10000, uint32_t buffers = 2);
+            ~TraceWriter();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+            void WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value) override;
+
+            // Writes out the partial block and waits until everything submitted is on disk.
+            void Flush();
+
+            // Stats
+            TraceStats GetStats() const;
+            const std::string &GetFilename() const;
+    };
+}
@@ -113,4 +113,79 @@ std::string RemoveWhitespaceFromString(const std::string &_str)
     std::string str = _str;
     str.erase(remove_if(str.begin(), str.end(), isspace), str.end());
     return str;
-}
\ No newline at end of file
+}
+
+// XXH64
+static const uint64_t HashPrime1 = 11400714785074694791ULL;
+static const uint64_t HashPrime2 = 14029467366897019727ULL;
+static const uint64_t HashPrime3 = 1609587929392839161ULL;
+static const uint64_t HashPrime4 = 9650029242287828579ULL;
+static const uint64_t HashPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t RotateLeft64(uint64_t n, int count) { return (n << count) | (n >> (64 - count)); }
+static inline uint64_t HashRound(uint64_t acc, uint64_t lane) { return RotateLeft64(acc + lane * HashPrime2, 31) * HashPrime1; }
+static inline uint64_t HashMerge(uint64_t acc, uint64_t value) { return (acc ^ HashRound(0, value)) * HashPrime1 + HashPrime4; }
+
+static inline uint64_t ReadLE64(const uint8_t *p)
+{
+    uint64_t n = 0;
+    for (int i = 7; i >= 0; i--)
+        n = (n << 8) | p[i];
+    return n;
+}
+
+static inline uint32_t ReadLE32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t HashBytes(const uint8_t *data, size_t length, uint64_t seed)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = data + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + HashPrime1 + HashPrime2;
+        uint64_t v2 = seed + HashPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HashPrime1;
+
+        do {
+            v1 = HashRound(v1, ReadLE64(p));
+            v2 = HashRound(v2, ReadLE64(p + 8));
+            v3 = HashRound(v3, ReadLE64(p + 16));
+            v4 = HashRound(v4, ReadLE64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12) + RotateLeft64(v4, 18);
+        h = HashMerge(h, v1);
+        h = HashMerge(h, v2);
+        h = HashMerge(h, v3);
+        h = HashMerge(h, v4);
+    } else {
+        h = seed + HashPrime5;
+    }
+
+    h += length;
+
+    for (; p + 8 <= end; p += 8)
+        h = RotateLeft64(h ^ HashRound(0, ReadLE64(p)), 27) * HashPrime1 + HashPrime4;
+
+    if (p + 4 <= end) {
+        h = RotateLeft64(h ^ (ReadLE32(p) * HashPrime1), 23) * HashPrime2 + HashPrime3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+        h = RotateLeft64(h ^ (*p * HashPrime5), 11) * HashPrime1;
+
+    h ^= h >> 33;
+    h *= HashPrime2;
+    h ^= h >> 29;
+    h *= HashPrime3;
+    h ^= h >> 32;
+
+    return h;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
 
 inline uint8_t ExtractBits8(uint8_t n, uint8_t pos, uint8_t count) { return (((1 << count) - 1) & (n >> (pos - 1))); }
 
@@ -11,4 +13,5 @@ uint64_t UIntFromHex(const std::string &hex);
 std::string LowercaseString(std::string str);
 std::string ReplaceSubstring(const std::string &str, const std::string &find, const std::string &replace);
 std::string TrimSurroundingWhitespace(const std::string &str);
-std::string RemoveWhitespaceFromString(const std::string &str);
\ No newline at end of file
+std::string RemoveWhitespaceFromString(const std::string &str);
+uint64_t HashBytes(const uint8_t *data, size_t length, uint64_t seed = 0);
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "Watchpoints.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "Util.h"
+
+namespace Emu8080
+{
+    const uint8_t Watchpoints::Execute;
+    const uint8_t Watchpoints::Read;
+    const uint8_t Watchpoints::Write;
+
+    Watchpoints::Watchpoints()
+    {
+        this->ClearAll();
+    }
+
+    int Watchpoints::IndexForType(uint8_t type)
+    {
+        switch (type) {
+            case Watchpoints::Execute: return 0;
+            case Watchpoints::Read: return 1;
+            case Watchpoints::Write: return 2;
+        }
+
+        throw std::runtime_error(FormatString("Malformed watch type %d.", type));
+    }
+
+    void Watchpoints::UpdatePage(uint8_t page)
+    {
+        uint8_t types = 0;
+
+        for (int i = 0; i < 3; i++) {
+            const uint64_t *words = this->bits[i] + page * 4;
+
+            if ((words[0] | words[1] | words[2] | words[3]) != 0)
+                types |= 1 << i;
+        }
+
+        this->pages[page] = types;
+    }
+
+    void Watchpoints::Trigger(uint8_t type, uint16_t addr, uint8_t value)
+    {
+        // The first hit of an instruction is the one reported.
+        if (this->triggered)
+            return;
+
+        this->triggered = true;
+        this->hit.type = type;
+        this->hit.addr = addr;
+        this->hit.value = value;
+        this->hit.pc = this->currentPC;
+    }
+
+    uint32_t Watchpoints::GetHooks() const { return HookFetch | HookRetire | HookRead | HookWrite; }
+
+    void Watchpoints::WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode)
+    {
+        this->executing = true;
+        this->currentPC = pc;
+    }
+
+    void Watchpoints::DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+    {
+        this->executing = false;
+    }
+
+    // Host accesses outside an instruction (loading ROMs, trap handlers) never trigger.
+    void Watchpoints::DidReadMemory(const CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (this->executing && this->IsSet(addr, Watchpoints::Read))
+            this->Trigger(Watchpoints::Read, addr, value);
+    }
+
+    void Watchpoints::WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value)
+    {
+        if (this->executing && this->IsSet(addr, Watchpoints::Write))
+            this->Trigger(Watchpoints::Write, addr, value);
+    }
+
+    void Watchpoints::Set(uint16_t addr, uint32_t length, uint8_t types)
+    {
+        for (uint32_t a = addr; a < std::min<uint32_t>(addr + length, 0x10000); a++) {
+            for (int i = 0; i < 3; i++) {
+                uint64_t bit = (uint64_t)1 << (a & 63);
+
+                if ((types & (1 << i)) != 0 && (this->bits[i][a >> 6] & bit) == 0) {
+                    this->bits[i][a >> 6] |= bit;
+                    this->counts[i]++;
+                }
+            }
+
+            this->pages[a >> 8] |= types & (Watchpoints::Execute | Watchpoints::Read | Watchpoints::Write);
+        }
+    }
+
+    void Watchpoints::Clear(uint16_t addr, uint32_t length, uint8_t types)
+    {
+        uint32_t end = std::min<uint32_t>(addr + length, 0x10000);
+
+        for (uint32_t a = addr; a < end; a++) {
+            for (int i = 0; i < 3; i++) {
+                uint64_t bit = (uint64_t)1 << (a & 63);
+
+                if ((types & (1 << i)) != 0 && (this->bits[i][a >> 6] & bit) != 0) {
+                    this->bits[i][a >> 6] &= ~bit;
+                    this->counts[i]--;
+                }
+            }
+        }
+
+        for (uint32_t page = addr >> 8; page < 0x100 && page << 8 < end; page++)
+            this->UpdatePage(page);
+    }
+
+    void Watchpoints::ClearAll()
+    {
+        std::fill(this->pages, this->pages + 0x100, 0);
+
+        for (int i = 0; i < 3; i++) {
+            std::fill(this->bits[i], this->bits[i] + 0x400, 0);
+            this->counts[i] = 0;
+        }
+
+        this->executing = false;
+        this->currentPC = 0;
+        this->triggered = false;
+        this->resumePC = -1;
+    }
+
+    bool Watchpoints::IsEmpty() const
+    {
+        return this->counts[0] == 0 && this->counts[1] == 0 && this->counts[2] == 0;
+    }
+
+    uint32_t Watchpoints::GetCount(uint8_t type) const { return this->counts[IndexForType(type)]; }
+
+    bool Watchpoints::CheckBreakpoint(uint16_t pc)
+    {
+        if (this->triggered)
+            return true;
+
+        // Resuming from a breakpoint steps over it once.
+        if (this->resumePC == pc) {
+            this->resumePC = -1;
+            return false;
+        }
+
+        this->resumePC = -1;
+
+        if (!this->IsSet(pc, Watchpoints::Execute))
+            return false;
+
+        this->currentPC = pc;
+        this->Trigger(Watchpoints::Execute, pc, 0);
+
+        return true;
+    }
+
+    bool Watchpoints::IsTriggered() const { return this->triggered; }
+    const WatchHit &Watchpoints::GetHit() const { return this->hit; }
+
+    void Watchpoints::Resume(uint16_t pc)
+    {
+        if (this->triggered && this->hit.type == Watchpoints::Execute)
+            this->resumePC = pc;
+
+        this->triggered = false;
+    }
+}
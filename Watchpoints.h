@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "CPUDelegate.h"
+
+namespace Emu8080
+{
+    struct WatchHit {
+        uint8_t type;
+        uint16_t addr;
+        uint8_t value;
+        uint16_t pc;
+    };
+
+    // Breakpoints and read/write watchpoints. A per-page summary of which types are set is consulted first, and
+    // the exact per-address bitmaps only on pages that have any, so unwatched accesses cost one byte load.
+    class Watchpoints : public CPUDelegate {
+        private:
+            uint8_t pages[0x100];
+            uint64_t bits[3][0x400];
+            uint32_t counts[3];
+
+            bool executing;
+            uint16_t currentPC;
+
+            bool triggered;
+            WatchHit hit;
+            int32_t resumePC;
+
+            static int IndexForType(uint8_t type);
+            void UpdatePage(uint8_t page);
+            void Trigger(uint8_t type, uint16_t addr, uint8_t value);
+
+        public:
+            // Types, combinable as a mask
+            static const uint8_t Execute = 1 << 0;
+            static const uint8_t Read = 1 << 1;
+            static const uint8_t Write = 1 << 2;
+
+            Watchpoints();
+
+            // CPUDelegate
+            uint32_t GetHooks() const override;
+            void WillExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode) override;
+            void DidExecuteInstruction(CPU * const cpu, uint16_t pc, uint8_t opcode, uint8_t cycles) override;
+            void DidReadMemory(const CPU * const cpu, uint16_t addr, uint8_t value) override;
+            void WillWriteMemory(CPU * const cpu, uint16_t addr, uint8_t value) override;
+
+            // Watches
+            void Set(uint16_t addr, uint32_t length, uint8_t types);
+            void Clear(uint16_t addr, uint32_t length, uint8_t types);
+            void ClearAll();
+            bool IsEmpty() const;
+            uint32_t GetCount(uint8_t type) const;
+
+            // type must be a single type; shifting it right by one gives its bitmap index.
+            inline bool IsSet(uint16_t addr, uint8_t type) const
+            {
+                return (this->pages[addr >> 8] & type) != 0 && ((this->bits[type >> 1][addr >> 6] >> (addr & 63)) & 1) != 0;
+            }
+
+            // Breakpoints are checked before an instruction executes; watchpoints trigger during it, and the
+            // instruction still completes.
+            bool CheckBreakpoint(uint16_t pc);
+            bool IsTriggered() const;
+            const WatchHit &GetHit() const;
+            void Resume(uint16_t pc);
+    };
+}
@@ -57,15 +57,20 @@ int main(int argc, char **argv)
     em->RegisterInterruptCallback(0x0, os, "reset");
     em->RegisterInterruptCallback(0x5, os, "msg");
 
-    while (true) {
-        em->Run();
-        
-        if (em->GetCPU()->GetState()->GetHalt())
-            break;
-
-        auto output = em->GetOutputStream();
-        if (!output.empty())
-            printf("%s", output.c_str());
+    try {
+        while (true) {
+            em->Run();
+
+            if (em->GetCPU()->GetState()->GetHalt())
+                break;
+
+            auto output = em->GetOutputStream();
+            if (!output.empty())
+                printf("%s", output.c_str());
+        }
+    } catch (const CPUFault &fault) {
+        fprintf(stderr, "\n%s\n%s", fault.what(), fault.Dump().c_str());
+        return 1;
     }
 
     printf("\n");
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Assembler.h"
+
+using namespace Emu8080;
+
+// Assembles a source file into a binary covering the emitted bytes, with an optional listing and symbol file.
+int main(int argc, char **argv)
+{
+    const char *output = nullptr;
+    const char *listing = nullptr;
+    const char *symbols = nullptr;
+    const char *input = nullptr;
+    bool usage = argc < 2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            listing = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            symbols = argv[++i];
+        else if (input == nullptr && argv[i][0] != '-')
+            input = argv[i];
+        else
+            usage = true;
+    }
+
+    if (usage || input == nullptr) {
+        fprintf(stderr, "usage: %s [-o out.bin] [-l out.lst] [-s out.sym] source.asm\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        Assembler assembler;
+        assembler.AssembleFile(input);
+
+        assembler.SaveBinary(output != nullptr ? output : "a.bin");
+
+        if (listing != nullptr)
+            assembler.SaveListing(listing);
+        if (symbols != nullptr)
+            assembler.SaveSymbols(symbols);
+
+        printf("%04x-%04x, %u bytes\n", assembler.GetStart(), assembler.GetEnd() > 0 ? assembler.GetEnd() - 1 : 0, assembler.GetEnd() - assembler.GetStart());
+        return 0;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s: %s\n", input, e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CPU.h"
+#include "Encode.h"
+#include "Conformance.h"
+
+using namespace Emu8080;
+
+// Runs the exhaustive ALU conformance sweep against CPU. Exits 0 if every case matches the reference model,
+// 1 on any mismatch and 2 on error.
+int main(int argc, char **argv)
+{
+    unsigned threads = 0;
+    size_t samples = 16;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            samples = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [-j threads] [-n samples]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    try {
+        ConformanceReport report = RunALUConformance<CPU>([]() { return new CPU(nullptr, 0x10000); }, threads, samples);
+
+        for (auto &failure : report.samples) {
+            printf("%02x %-4s a=%02x operand=%02x flags=%02x: expected a=%02x flags=%02x, got a=%02x flags=%02x\n",
+                failure.opcode, Encode::DecodeMnemonic(failure.opcode).c_str(), failure.a, failure.operand, failure.flags,
+                failure.expectedA, failure.expectedFlags, failure.actualA, failure.actualFlags);
+        }
+
+        printf("%llu cases, %llu failures in %.2f s\n", (unsigned long long)report.cases, (unsigned long long)report.failures, report.seconds);
+        return report.failures == 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "conformance: %s\n", e.what());
+        return 2;
+    }
+}
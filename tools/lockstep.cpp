@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "CPU.h"
+#include "Lockstep.h"
+#include "Util.h"
+
+using namespace Emu8080;
+
+// Asks for every hook, so the CPU it is attached to runs the fully instrumented tier.
+class AllHooksDelegate : public CPUDelegate {
+};
+
+static void LoadROM(CPU * const cpu, const char * const filename, uint16_t origin)
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (file == nullptr)
+        throw std::runtime_error(FormatString("Failed to open '%s'.", filename));
+
+    std::vector<uint8_t> data(0x10000 - origin);
+    size_t size = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    cpu->WriteBytes(origin, data.data(), size);
+    cpu->WritePC(origin);
+}
+
+// Runs the bare core against the instrumented one in lockstep, over a ROM or over generated instruction streams.
+// Exits 0 if they agree, 1 if they diverge and 2 on error.
+int main(int argc, char **argv)
+{
+    uint64_t seeds = 16;
+    uint64_t instructions = 1000000;
+    uint32_t interval = 1000;
+    uint16_t origin = 0x100;
+    const char *rom = nullptr;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seeds = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            instructions = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            interval = strtoul(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            origin = strtoul(argv[++i], nullptr, 0);
+        else if (rom == nullptr && argv[i][0] != '-')
+            rom = argv[i];
+        else
+            usage = true;
+    }
+
+    if (usage) {
+        fprintf(stderr, "usage: %s [-s seeds] [-n instructions] [-i interval] [-o origin] [rom.bin]\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        uint64_t runs = rom != nullptr ? 1 : seeds;
+        uint64_t diverged = 0;
+        uint64_t total = 0;
+
+        for (uint64_t seed = 0; seed < runs; seed++) {
+            CPU reference(nullptr, 0x10000);
+            CPU candidate(nullptr, 0x10000);
+            AllHooksDelegate delegate;
+
+            candidate.AddDelegate(&delegate);
+
+            if (rom != nullptr)
+                LoadROM(&reference, rom, origin);
+            else
+                RandomizeState(reference.GetState(), seed);
+
+            reference.GetState()->CopyTo(candidate.GetState());
+
+            Lockstep<CPU, CPU> lockstep(&reference, &candidate, interval);
+            LockstepResult result = lockstep.Run(instructions);
+
+            total += result.instructions;
+
+            if (!result.diverged)
+                continue;
+
+            diverged++;
+
+            if (rom != nullptr)
+                printf("%s: ", rom);
+            else
+                printf("seed %llu: ", (unsigned long long)seed);
+
+            if (result.reproduced) {
+                printf("diverged at instruction %llu, pc %04x opcode %02x: %s\n", (unsigned long long)result.divergentInstruction,
+                    result.pc, result.opcode, result.diff.ToString().c_str());
+            } else {
+                printf("diverged between instructions %llu and %llu but not on replay: %s\n", (unsigned long long)result.intervalStart,
+                    (unsigned long long)result.intervalEnd, result.diff.ToString().c_str());
+            }
+
+            if (result.referenceError != result.candidateError)
+                printf("  reference: '%s', candidate: '%s'\n", result.referenceError.c_str(), result.candidateError.c_str());
+        }
+
+        printf("%llu runs, %llu instructions, %llu diverged\n", (unsigned long long)runs, (unsigned long long)total, (unsigned long long)diverged);
+        return diverged == 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "lockstep: %s\n", e.what());
+        return 2;
+    }
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TraceDiff.h"
+
+using namespace Emu8080;
+
+// Compares two traces written by TraceWriter. Exits 0 if they are identical, 1 if they differ and 2 on error.
+int main(int argc, char **argv)
+{
+    unsigned threads = 0;
+    size_t runs = 16;
+    const char *files[2] = { nullptr, nullptr };
+    int fileCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (fileCount < 2)
+            files[fileCount++] = argv[i];
+        else
+            fileCount++;
+    }
+
+    if (fileCount != 2) {
+        fprintf(stderr, "usage: %s [-j threads] [-n runs] a.trace b.trace\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        TraceReader a(files[0]);
+        TraceReader b(files[1]);
+        TraceDiff diff;
+
+        DiffTraces(&a, &b, &diff, threads, runs);
+        printf("%s", diff.ToString().c_str());
+
+        return diff.IsEmpty() ? 0 : 1;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+}